@@ -0,0 +1,515 @@
+#pragma once
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <ostream>
+#include <fstream>
+#include <type_traits>
+#include <algorithm>
+
+
+#define GDBASE_LOGGER_BUFFER_SIZE 65536		//Default size in bytes of each thread's ring buffer. Rounded up to a power of 2.
+#define GDBASE_LOGGER_FLUSH_INTERVAL_MS 5	//How long the writer thread sleeps when there is nothing to write.
+#ifndef GDBASE_CACHE_LINE_SIZE
+#define GDBASE_CACHE_LINE_SIZE 64
+#endif
+
+
+namespace GDBase
+{
+	//Class declarations
+	enum class LogOverflowPolicy
+	{
+		Drop,		//Records that do not fit in the calling thread's buffer are discarded and counted.
+		Block		//The calling thread waits until the writer thread has made room.
+	};
+
+	namespace impl
+	{
+		using LogFormatFn = void (*)(std::ostream&, const char*);	//Decodes a record payload and writes it to a stream.
+
+		struct LogRecordHeader;		//Header preceding every record in a LogRingBuffer.
+
+		template <class T, class Enable = void>
+		struct LogArg;				//Binary encoding of a single log argument.
+
+		class LogRingBuffer;		//Single producer single consumer byte ring buffer owned by one logging thread.
+
+		class LogThreadCache;		//Per thread list of ring buffers, one per logger the thread has logged to.
+	};
+
+	class AsyncLogger;		//Logger that formats and writes records on a background thread.
+
+	//Class definitions
+	struct impl::LogRecordHeader
+	{
+		LogFormatFn format;			//nullptr marks padding at the end of the buffer.
+		uint32_t size;				//Size of the record including this header.
+	};
+
+	//Arithmetic types are copied as is and formatted with operator<<.
+	template <class T>
+	struct impl::LogArg<T, std::enable_if_t<std::is_arithmetic_v<T>>>
+	{
+		static size_t size(const T&) { return sizeof(T); }
+		static void encode(char*& dest, const T& value) { std::memcpy(dest, &value, sizeof(T)); dest += sizeof(T); }
+		static void decode(std::ostream& out, const char*& src)
+		{
+			T value;
+			std::memcpy(&value, src, sizeof(T));
+			src += sizeof(T);
+			out << value;
+		}
+	};
+
+	//Strings are copied into the record since the caller's buffer may not outlive it.
+	template <>
+	struct impl::LogArg<std::string_view>
+	{
+		static size_t size(std::string_view value) { return sizeof(uint32_t) + value.size(); }
+		static void encode(char*& dest, std::string_view value)
+		{
+			auto length = (uint32_t)value.size();
+			std::memcpy(dest, &length, sizeof(uint32_t));
+			std::memcpy(dest + sizeof(uint32_t), value.data(), length);
+			dest += sizeof(uint32_t) + length;
+		}
+		static void decode(std::ostream& out, const char*& src)
+		{
+			uint32_t length;
+			std::memcpy(&length, src, sizeof(uint32_t));
+			out.write(src + sizeof(uint32_t), length);
+			src += sizeof(uint32_t) + length;
+		}
+	};
+
+	template <>
+	struct impl::LogArg<std::string> : impl::LogArg<std::string_view> {};
+
+	template <>
+	struct impl::LogArg<const char*> : impl::LogArg<std::string_view>
+	{
+		static size_t size(const char* value) { return LogArg<std::string_view>::size(value != nullptr ? value : ""); }
+		static void encode(char*& dest, const char* value) { LogArg<std::string_view>::encode(dest, value != nullptr ? value : ""); }
+	};
+
+	template <>
+	struct impl::LogArg<char*> : impl::LogArg<const char*> {};
+
+	/*
+		LogRingBuffer
+		Byte ring buffer written by exactly one thread and read by the logger's writer thread.
+		Records never wrap; if a record does not fit before the end of the buffer the remainder is filled with padding.
+	*/
+	class impl::LogRingBuffer
+	{
+	public:
+		static constexpr size_t RECORD_ALIGNMENT = sizeof(LogRecordHeader);
+		static_assert((RECORD_ALIGNMENT & (RECORD_ALIGNMENT - 1)) == 0, "LogRecordHeader size must be a power of 2.");
+
+		explicit LogRingBuffer(size_t capacity) : head_(0), tailCache_(0), tail_(0), orphaned_(false), dropped_(0)
+		{
+			//Round capacity up to a power of 2 so positions can be masked.
+			capacity_ = RECORD_ALIGNMENT;
+			while (capacity_ < capacity)
+			{
+				capacity_ <<= 1;
+			}
+			buffer_ = std::make_unique<char[]>(capacity_);
+		}
+
+		size_t capacity() const { return capacity_; }
+
+		/*
+			Reserves size bytes (a multiple of RECORD_ALIGNMENT) for one record and returns where to write it.
+			Returns nullptr if there is not enough room. Must be followed by commit().
+		*/
+		char* tryAcquire(size_t size)
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+			auto offset = head & (capacity_ - 1);
+			auto contiguous = capacity_ - offset;
+
+			//Records never wrap; pad out the end of the buffer and start the record at the beginning.
+			if (size > contiguous)
+			{
+				if (!hasRoom(head, contiguous))
+				{
+					return nullptr;
+				}
+				auto padding = reinterpret_cast<LogRecordHeader*>(buffer_.get() + offset);
+				padding->format = nullptr;
+				padding->size = (uint32_t)contiguous;
+				head += contiguous;
+				head_.store(head, std::memory_order_release);
+				offset = 0;
+			}
+
+			if (!hasRoom(head, size))
+			{
+				return nullptr;
+			}
+			pendingHead_ = head + size;
+			return buffer_.get() + offset;
+		}
+
+		//Publishes the record written after the last tryAcquire.
+		void commit() { head_.store(pendingHead_, std::memory_order_release); }
+
+		//Formats every record written so far into out. Returns the number of records written. Writer thread only.
+		size_t drain(std::ostream& out)
+		{
+			auto head = head_.load(std::memory_order_acquire);
+			auto tail = tail_.load(std::memory_order_relaxed);
+			size_t records = 0;
+
+			while (tail != head)
+			{
+				auto record = buffer_.get() + (tail & (capacity_ - 1));
+				auto header = reinterpret_cast<const LogRecordHeader*>(record);
+				if (header->format != nullptr)
+				{
+					header->format(out, record + sizeof(LogRecordHeader));
+					records++;
+				}
+				tail += header->size;
+				tail_.store(tail, std::memory_order_release);	//Release space as soon as possible so blocked producers can continue.
+			}
+			return records;
+		}
+
+		bool isEmpty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+		bool isOrphaned() const { return orphaned_.load(std::memory_order_acquire); }
+		void setOrphaned(bool orphaned) { orphaned_.store(orphaned, std::memory_order_release); }
+
+		void addDropped() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+		size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+	private:
+		std::unique_ptr<char[]> buffer_;
+		size_t capacity_;
+
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic_size_t head_;	//Producer position. Written by the owning thread only.
+		size_t pendingHead_;
+		size_t tailCache_;											//Producer's last seen value of tail_.
+
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic_size_t tail_;	//Consumer position. Written by the writer thread only.
+
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic_bool orphaned_;	//Set when the owning thread exits so the buffer can be reused.
+		std::atomic_size_t dropped_;
+
+		//Whether size bytes are free after head. Only touches the consumer's cache line when the cached tail is not enough.
+		bool hasRoom(size_t head, size_t size)
+		{
+			if (capacity_ - (head - tailCache_) >= size)
+			{
+				return true;
+			}
+			tailCache_ = tail_.load(std::memory_order_acquire);
+			return capacity_ - (head - tailCache_) >= size;
+		}
+	};
+
+	/*
+		LogThreadCache
+		Holds the ring buffers of the current thread. Buffers are shared with their logger so either may outlive the other.
+		When the thread exits its buffers are marked as orphaned and handed to the next new thread of the same logger.
+		A buffer only referenced by the cache belongs to a destroyed logger; those are dropped the next time the thread adds
+		a buffer, so the cache only grows with the number of loggers alive at once.
+	*/
+	class impl::LogThreadCache
+	{
+	public:
+		~LogThreadCache()
+		{
+			for (auto& entry : buffers_)
+			{
+				entry.second->setOrphaned(true);
+			}
+		}
+
+		LogRingBuffer* find(uint64_t loggerId)
+		{
+			if (lastId_ == loggerId)
+			{
+				return lastBuffer_;
+			}
+
+			for (auto& entry : buffers_)
+			{
+				if (entry.first == loggerId)
+				{
+					lastId_ = loggerId;
+					lastBuffer_ = entry.second.get();
+					return lastBuffer_;
+				}
+			}
+			return nullptr;
+		}
+
+		void add(uint64_t loggerId, std::shared_ptr<LogRingBuffer> buffer)
+		{
+			buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [](auto& entry) { return entry.second.use_count() == 1; }), buffers_.end());
+			lastId_ = loggerId;
+			lastBuffer_ = buffer.get();
+			buffers_.emplace_back(loggerId, std::move(buffer));
+		}
+
+		size_t size() const { return buffers_.size(); }
+
+		static LogThreadCache& current()
+		{
+			static thread_local LogThreadCache cache;
+			return cache;
+		}
+
+	private:
+		std::vector<std::pair<uint64_t, std::shared_ptr<LogRingBuffer>>> buffers_;
+		uint64_t lastId_ = 0;				//Logger ids start at 1.
+		LogRingBuffer* lastBuffer_ = nullptr;
+	};
+
+	/*
+		AsyncLogger
+		Thread safe logger. Logging threads encode their arguments in binary into a per thread lock free ring buffer;
+		a background writer thread formats the records and writes them to the output in batches.
+		Supported argument types are arithmetic types, const char*, std::string and std::string_view.
+	*/
+	class AsyncLogger
+	{
+	public:
+		/*
+			AsyncLogger Constructor
+			@out		Path of the file to write to.
+			@policy		What to do when a thread's buffer is full.
+			@bufferSize	Size in bytes of each thread's ring buffer, rounded up to a power of 2.
+		*/
+		explicit AsyncLogger(const char* out, LogOverflowPolicy policy = LogOverflowPolicy::Drop, size_t bufferSize = GDBASE_LOGGER_BUFFER_SIZE)
+			: file_(out), out_(file_), policy_(policy), bufferSize_(bufferSize)
+		{
+			start();
+		}
+
+		//Writes to out instead of a file. out must outlive the logger.
+		explicit AsyncLogger(std::ostream& out, LogOverflowPolicy policy = LogOverflowPolicy::Drop, size_t bufferSize = GDBASE_LOGGER_BUFFER_SIZE)
+			: out_(out), policy_(policy), bufferSize_(bufferSize)
+		{
+			start();
+		}
+
+		AsyncLogger(const AsyncLogger&) = delete;
+		AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+		//Writes all pending records and stops the writer thread.
+		~AsyncLogger()
+		{
+			{
+				std::lock_guard<std::mutex> guard(writerLock_);
+				running_ = false;
+			}
+			writerWake_.notify_one();
+			writer_.join();
+		}
+
+		//Logs the arguments. Returns false if the record was dropped.
+		template <class... Args>
+		bool log(const Args&... args) { return write<false>(args...); }
+
+		//Logs the arguments followed by a newline. Returns false if the record was dropped.
+		template <class... Args>
+		bool logln(const Args&... args) { return write<true>(args...); }
+
+		bool nl() { return write<true>(); }
+
+		/*
+			Blocks until every record logged before the call has been written and the output has been flushed.
+			Call before shutdown or before reading the output.
+		*/
+		void flush()
+		{
+			std::unique_lock<std::mutex> guard(writerLock_);
+			auto request = ++flushRequested_;
+			writerWake_.notify_one();
+			flushDone_.wait(guard, [&] { return flushCompleted_ >= request; });
+		}
+
+		//Number of records discarded because a buffer was full.
+		size_t droppedCount()
+		{
+			std::lock_guard<std::mutex> guard(buffersLock_);
+			size_t dropped = 0;
+			for (auto& buffer : buffers_)
+			{
+				dropped += buffer->dropped();
+			}
+			return dropped;
+		}
+
+		LogOverflowPolicy getPolicy() const { return policy_; }
+
+	private:
+		std::ofstream file_;
+		std::ostream& out_;
+		LogOverflowPolicy policy_;
+		size_t bufferSize_;
+		uint64_t id_;										//Identifies this logger in each thread's LogThreadCache.
+
+		std::vector<std::shared_ptr<impl::LogRingBuffer>> buffers_;	//Every buffer created by this logger.
+		std::mutex buffersLock_;							//Only taken the first time a thread logs and by the writer thread.
+
+		std::thread writer_;
+		std::mutex writerLock_;
+		std::condition_variable writerWake_;
+		std::condition_variable flushDone_;
+		bool running_ = true;
+		uint64_t flushRequested_ = 0;
+		uint64_t flushCompleted_ = 0;
+
+		void start()
+		{
+			static std::atomic<uint64_t> nextId(1);
+			id_ = nextId++;
+			writer_ = std::thread(&AsyncLogger::run, this);
+		}
+
+		template <bool newline, class... Args>
+		static void format(std::ostream& out, const char* payload)
+		{
+			(impl::LogArg<std::decay_t<Args>>::decode(out, payload), ...);
+			(void)payload;		//Unused when there are no arguments.
+			if (newline)
+			{
+				out << '\n';
+			}
+		}
+
+		template <bool newline, class... Args>
+		bool write(const Args&... args)
+		{
+			constexpr auto alignment = impl::LogRingBuffer::RECORD_ALIGNMENT;
+			size_t size = sizeof(impl::LogRecordHeader) + (size_t(0) + ... + impl::LogArg<std::decay_t<Args>>::size(args));
+			size = (size + alignment - 1) & ~(alignment - 1);
+
+			auto buffer = localBuffer();
+			if (size > buffer->capacity())	//Can never fit.
+			{
+				buffer->addDropped();
+				return false;
+			}
+
+			char* record;
+			while ((record = buffer->tryAcquire(size)) == nullptr)
+			{
+				if (policy_ == LogOverflowPolicy::Drop)
+				{
+					buffer->addDropped();
+					return false;
+				}
+				writerWake_.notify_one();
+				std::this_thread::yield();
+			}
+
+			auto header = reinterpret_cast<impl::LogRecordHeader*>(record);
+			header->format = &AsyncLogger::format<newline, Args...>;
+			header->size = (uint32_t)size;
+
+			char* payload = record + sizeof(impl::LogRecordHeader);
+			(impl::LogArg<std::decay_t<Args>>::encode(payload, args), ...);
+			(void)payload;		//Unused when there are no arguments.
+			buffer->commit();
+			return true;
+		}
+
+		//Returns the calling thread's buffer, creating or reclaiming one on first use.
+		impl::LogRingBuffer* localBuffer()
+		{
+			auto& cache = impl::LogThreadCache::current();
+			auto buffer = cache.find(id_);
+			if (buffer != nullptr)
+			{
+				return buffer;
+			}
+
+			std::shared_ptr<impl::LogRingBuffer> newBuffer;
+			{
+				std::lock_guard<std::mutex> guard(buffersLock_);
+				for (auto& existing : buffers_)
+				{
+					//A buffer left by an exited thread can be reused once everything in it is written.
+					if (existing->isOrphaned() && existing->isEmpty())
+					{
+						existing->setOrphaned(false);
+						newBuffer = existing;
+						break;
+					}
+				}
+
+				if (!newBuffer)
+				{
+					newBuffer = std::make_shared<impl::LogRingBuffer>(bufferSize_);
+					buffers_.push_back(newBuffer);
+				}
+			}
+			buffer = newBuffer.get();
+			cache.add(id_, std::move(newBuffer));
+			return buffer;
+		}
+
+		//Writes every pending record once. Returns the number of records written.
+		size_t drainAll()
+		{
+			std::lock_guard<std::mutex> guard(buffersLock_);
+			size_t records = 0;
+			for (auto& buffer : buffers_)
+			{
+				records += buffer->drain(out_);
+			}
+			return records;
+		}
+
+		//Writer thread.
+		void run()
+		{
+			std::unique_lock<std::mutex> guard(writerLock_);
+			while (true)
+			{
+				auto running = running_;
+				auto request = flushRequested_;
+				guard.unlock();
+
+				//Everything logged before request was made is written by this pass.
+				if (drainAll() > 0 || request > flushCompleted_)
+				{
+					out_.flush();	//One flush per batch instead of one per record.
+				}
+
+				guard.lock();
+				if (request > flushCompleted_)
+				{
+					flushCompleted_ = request;
+					flushDone_.notify_all();
+				}
+
+				if (!running)
+				{
+					break;
+				}
+
+				if (flushRequested_ == flushCompleted_ && running_)
+				{
+					writerWake_.wait_for(guard, std::chrono::milliseconds(GDBASE_LOGGER_FLUSH_INTERVAL_MS));
+				}
+			}
+		}
+	};
+};
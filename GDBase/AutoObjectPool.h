@@ -11,8 +11,6 @@
 
 #include "ObjectPool.h"
 
-#define GDBASE_INVALID_ID (size_t)-1
-
 namespace GDBase
 {
 	//Class declarations
@@ -34,11 +32,18 @@ namespace GDBase
 	public:
 		PoolObject() : object_(nullptr) {}
 		PoolObject(impl::InternalPoolObj<Obj>& obj) : object_(&obj) { if(object_ != nullptr) object_->incrementCounter(); }		//Increment counter on creation
-		PoolObject(PoolObject<Obj>& obj) : object_(obj.object_) { if(object_ != nullptr) object_->incrementCounter(); }			//
+		PoolObject(const PoolObject<Obj>& obj) : object_(obj.object_) { if(object_ != nullptr) object_->incrementCounter(); }			//
 
-		~PoolObject() { object_->decrementCounter(); }							//Decrement reference counter on deletion
+		~PoolObject() { if(object_ != nullptr) object_->decrementCounter(); }							//Decrement reference counter on deletion
 
-		PoolObject<Obj> operator=(const PoolObject<Obj>& other) { object_ = other.object_; object_->incrementCounter(); }
+		//Increment the new object's counter before decrementing the old one's so self assignment does not release the object.
+		PoolObject<Obj>& operator=(const PoolObject<Obj>& other)
+		{
+			if (other.object_ != nullptr) other.object_->incrementCounter();
+			if (object_ != nullptr) object_->decrementCounter();
+			object_ = other.object_;
+			return *this;
+		}
 		auto& operator*() { return **object_; }
 		auto operator->() { return object_->getPointer(); }
 
@@ -63,14 +68,14 @@ namespace GDBase
 			@defaultObject	What to initialize objects as.
 			@initialSize	Initial size of the object pool rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
 		*/
-		explicit AutoObjectPool<Obj>(Obj& defaultObject = Obj(), size_t initialSize = 1000) : ObjectPool<impl::InternalPoolObj<Obj>>(initialSize), defaultObject_(defaultObject)
+		explicit AutoObjectPool<Obj>(const Obj& defaultObject = Obj(), size_t initialSize = 1000) : ObjectPool<impl::InternalPoolObj<Obj>>(initialSize), defaultObject_(defaultObject)
 		{
 			//Set internal pool object values created by ObjectPool constructor.
 			for (size_t block = 0; block < capacity_ / GDBASE_OBJECTPOOL_BLOCK_SIZE; block++)
 			{
 				for (size_t i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
 				{
-					poolObjects_[block][i].setValues(this, block * GDBASE_OBJECTPOOL_BLOCK_SIZE + i);
+					poolObjects_[block][i].setValues(this, (PoolIndex)(block * GDBASE_OBJECTPOOL_BLOCK_SIZE + i));
 				}
 			}
 		}
@@ -99,9 +104,9 @@ namespace GDBase
 		virtual void makePoolObjects(PoolObject<Obj>*& objects, size_t nObjects)
 		{
 			objects = new PoolObject<Obj>[nObjects];
-			size_t* ids;
+			PoolIndex* ids;
 			ObjectPool::reserveMultiple(ids, nObjects);
-			size_t id;
+			PoolIndex id;
 			for (size_t i = 0; i < nObjects; i++)
 			{
 				id = ids[i];
@@ -109,7 +114,7 @@ namespace GDBase
 			}
 		}*/
 
-		virtual bool isInUse(size_t index) { return ObjectPool::isInUse(index); }	//Returns whether object at index is in use or not.
+		virtual bool isInUse(PoolIndex index) { return ObjectPool::isInUse(index); }	//Returns whether object at index is in use or not.
 
 		Obj& getDefaultObject() { return defaultObject_; }
 		Obj& setDefaultObject(Obj& newObj) { defaultObject_ = newObj; }
@@ -119,7 +124,7 @@ namespace GDBase
 			Sets pointer to first free object to index if index specifies an earlier position and mark object as unused.
 			When overloading, it is recommended to call the base function after resetting values if at all.
 		*/
-		virtual void resetObject(size_t index)
+		virtual void resetObject(PoolIndex index)
 		{
 			auto curPosition = currentPosition_.load();
 			isInUse_[index].val.store(false);	//Set flag to unused.
@@ -138,8 +143,8 @@ namespace GDBase
 			if (capacity_ < newCapacity)
 			{
 				//objects_.reserve(newCapacity);
-				isInUse_.resize(newCapacity);
 				auto nNewBlocks = newCapacity / GDBASE_OBJECTPOOL_BLOCK_SIZE;
+				isInUse_.addBlocks(nNewBlocks);
 
 				//Create and populate new blocks
 				for (size_t block = capacity_ / GDBASE_OBJECTPOOL_BLOCK_SIZE; block < nNewBlocks; block++)
@@ -148,7 +153,7 @@ namespace GDBase
 
 					for (size_t index = 0; index < GDBASE_OBJECTPOOL_BLOCK_SIZE; index++)
 					{
-						poolObjects_[block][index].setValues(this, block * GDBASE_OBJECTPOOL_BLOCK_SIZE + index);
+						poolObjects_[block][index].setValues(this, (PoolIndex)(block * GDBASE_OBJECTPOOL_BLOCK_SIZE + index));
 					}
 				}
 
@@ -164,13 +169,13 @@ namespace GDBase
 		//Constructors set the ObjectPool that owns the object and starts the reference counter at 0.
 		InternalPoolObj() :owner_(0), id_(GDBASE_INVALID_ID), count_(0) {}
 
-		InternalPoolObj(AutoObjectPool<Obj>* owner, size_t index) : owner_(owner), id_(index), count_(0), object_(owner->getDefaultObject()) {}
+		InternalPoolObj(AutoObjectPool<Obj>* owner, PoolIndex index) : owner_(owner), id_(index), count_(0), object_(owner->getDefaultObject()) {}
 
 		InternalPoolObj(const InternalPoolObj<Obj>& defaultValue) : InternalPoolObj(defaultValue.owner_, defaultValue.id_) {}
 
 		~InternalPoolObj() {}
 
-		void setValues(AutoObjectPool<Obj>* owner, size_t index)
+		void setValues(AutoObjectPool<Obj>* owner, PoolIndex index)
 		{
 			owner_ = owner;
 			id_ = index;
@@ -189,9 +194,11 @@ namespace GDBase
 
 		const auto Index() { return id_; }
 
+		const auto Count() { return count_.load(); }	//Number of PoolObjects referencing this object.
+
 	private:
 		Obj object_;				//The object stored.
-		size_t id_;					//Object ID (index of the object in object pool)
+		PoolIndex id_;				//Object ID (index of the object in object pool)
 		AutoObjectPool<Obj>* owner_;	//ObjectPool that owns this object.
 		std::atomic_int count_;		//Reference counter. When the counter reaches 0, this object will reset itself to the default object specified by owner_.
 	};
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <bitset>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "ObjectPool.h"
+#include "JobScheduler.h"
+
+#define GDBASE_ECS_MAX_COMPONENTS 64		//Number of component types, counted across the whole program, that entities record in their component mask.
+#define GDBASE_ECS_PAGE_SIZE 1024			//Number of entities covered by one page of a sparse index.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		class ComponentStorageBase;		//Type erased interface of a ComponentStorage, used to destroy entities.
+
+		inline size_t nextComponentTypeId();
+
+		template <class C>
+		size_t componentTypeId();		//Id of a component type, unique within the program.
+	}
+
+	template <class C>
+	class ComponentStorage;		//Sparse set of components of one type.
+
+	template <class... Cs>
+	class View;					//Iterates the entities that have all of a set of components.
+
+	class EntityRegistry;		//Issues entities and owns their component storages.
+
+	//Class definitions
+	inline size_t impl::nextComponentTypeId()
+	{
+		static std::atomic_size_t next(0);
+		return next++;
+	}
+
+	template <class C>
+	size_t impl::componentTypeId()
+	{
+		static const size_t id = nextComponentTypeId();
+		return id;
+	}
+
+	class impl::ComponentStorageBase
+	{
+	public:
+		virtual ~ComponentStorageBase() = default;
+		virtual void remove(PoolIndex entity) = 0;
+	};
+
+	/*
+		ComponentStorage
+		Sparse set of components of type C. Components are packed in a dense array in no particular order, with a parallel
+		array of the entities they belong to. A paged sparse index maps an entity to its position in the dense arrays.
+		Adding a component appends it; removing one moves the last component into its place.
+	*/
+	template <class C>
+	class ComponentStorage : public impl::ComponentStorageBase
+	{
+	public:
+		bool contains(PoolIndex entity) const { return denseIndex(entity) != GDBASE_INVALID_ID; }
+
+		//Constructs a component for entity, replacing any it already has.
+		template <class... Args>
+		C& emplace(PoolIndex entity, Args&&... args)
+		{
+			auto index = denseIndex(entity);
+			if (index != GDBASE_INVALID_ID)
+			{
+				components_[index] = make(std::forward<Args>(args)...);
+				return components_[index];
+			}
+
+			sparseSlot(entity) = (PoolIndex)entities_.size();
+			entities_.push_back(entity);
+			components_.push_back(make(std::forward<Args>(args)...));
+			return components_.back();
+		}
+
+		//Removes entity's component. Does nothing if it has none.
+		virtual void remove(PoolIndex entity)
+		{
+			auto index = denseIndex(entity);
+			if (index == GDBASE_INVALID_ID)
+			{
+				return;
+			}
+
+			//Move the last component into the hole.
+			auto last = entities_.back();
+			if (last != entity)
+			{
+				components_[index] = std::move(components_.back());
+				entities_[index] = last;
+				sparseSlot(last) = index;
+			}
+			components_.pop_back();
+			entities_.pop_back();
+			sparseSlot(entity) = GDBASE_INVALID_ID;
+		}
+
+		//entity must have the component.
+		C& get(PoolIndex entity) { return components_[denseIndex(entity)]; }
+
+		//Returns nullptr if entity does not have the component.
+		C* tryGet(PoolIndex entity)
+		{
+			auto index = denseIndex(entity);
+			return index != GDBASE_INVALID_ID ? &components_[index] : nullptr;
+		}
+
+		size_t size() const { return entities_.size(); }
+		bool isEmpty() const { return entities_.empty(); }
+
+		//Dense arrays. The component at position i belongs to entities()[i].
+		const std::vector<PoolIndex>& entities() const { return entities_; }
+		C* data() { return components_.data(); }
+
+		typename std::vector<C>::iterator begin() { return components_.begin(); }
+		typename std::vector<C>::iterator end() { return components_.end(); }
+
+		//Position of entity's component in the dense arrays, or GDBASE_INVALID_ID.
+		PoolIndex denseIndex(PoolIndex entity) const
+		{
+			auto page = entity / GDBASE_ECS_PAGE_SIZE;
+			return page < sparse_.size() && sparse_[page] != nullptr ? sparse_[page][entity % GDBASE_ECS_PAGE_SIZE] : GDBASE_INVALID_ID;
+		}
+
+	private:
+		std::vector<std::unique_ptr<PoolIndex[]>> sparse_;		//Pages of the sparse index, allocated on first use.
+		std::vector<PoolIndex> entities_;
+		std::vector<C> components_;
+
+		//Aggregates are brace initialized so plain structs can be emplaced from their members.
+		template <class... Args>
+		static C make(Args&&... args)
+		{
+			if constexpr (std::is_aggregate_v<C>)
+			{
+				return C{ std::forward<Args>(args)... };
+			}
+			else
+			{
+				return C(std::forward<Args>(args)...);
+			}
+		}
+
+		PoolIndex& sparseSlot(PoolIndex entity)
+		{
+			auto page = entity / GDBASE_ECS_PAGE_SIZE;
+			if (page >= sparse_.size())
+			{
+				sparse_.resize(page + 1);
+			}
+			if (sparse_[page] == nullptr)
+			{
+				sparse_[page] = std::make_unique<PoolIndex[]>(GDBASE_ECS_PAGE_SIZE);
+				std::fill_n(sparse_[page].get(), GDBASE_ECS_PAGE_SIZE, GDBASE_INVALID_ID);
+			}
+			return sparse_[page][entity % GDBASE_ECS_PAGE_SIZE];
+		}
+	};
+
+	/*
+		View
+		Iterates the entities that have every component in Cs. Iteration walks the dense array of the smallest storage
+		and looks the entity up in the others, so its cost follows the rarest component.
+		fn may change the components it is given and may remove components of the entity it is given;
+		it must not add components or create or destroy entities.
+	*/
+	template <class... Cs>
+	class View
+	{
+	public:
+		explicit View(ComponentStorage<Cs>*... storages) : storages_(storages...) {}
+
+		//Calls fn(entity, Cs&...) for every entity that has all components.
+		template <class F>
+		void each(F&& fn)
+		{
+			auto& entities = smallest();
+
+			//Backwards so removing the current entity's components only moves entities that were already visited.
+			for (auto i = entities.size(); i-- > 0;)
+			{
+				visit(entities[i], fn);
+			}
+		}
+
+		/*
+			Calls fn(entity, Cs&...) like each(), split across scheduler's workers. Returns once all calls are done.
+			fn is called concurrently for different entities, so it must not remove components.
+			@grain	Number of entities handled by one job. 0 lets the scheduler pick.
+		*/
+		template <class F>
+		void parallelEach(JobScheduler& scheduler, F&& fn, size_t grain = 0)
+		{
+			auto& entities = smallest();
+			scheduler.parallelFor(0, entities.size(), [this, &entities, &fn](size_t i) { visit(entities[i], fn); }, grain);
+		}
+
+		//Upper bound on the number of entities visited.
+		size_t sizeHint() const { return smallest().size(); }
+
+	private:
+		std::tuple<ComponentStorage<Cs>*...> storages_;
+
+		//Dense entity array of the storage with the fewest components, which drives the iteration.
+		const std::vector<PoolIndex>& smallest() const
+		{
+			const std::vector<PoolIndex>* entities = nullptr;
+			auto pick = [&entities](auto* storage)
+			{
+				if (entities == nullptr || storage->size() < entities->size())
+				{
+					entities = &storage->entities();
+				}
+			};
+			std::apply([&pick](auto*... storages) { (pick(storages), ...); }, storages_);
+			return *entities;
+		}
+
+		template <class F>
+		void visit(PoolIndex entity, F& fn)
+		{
+			if (std::apply([entity](auto*... storages) { return (storages->contains(entity) && ...); }, storages_))
+			{
+				fn(entity, std::get<ComponentStorage<Cs>*>(storages_)->get(entity)...);
+			}
+		}
+	};
+
+	/*
+		EntityRegistry
+		Issues entity ids from an ObjectPool and keeps one ComponentStorage per component type.
+		Each entity's pool object records which component types it has, so destroying it only touches those storages.
+		Component type ids are issued program wide, in the order types are first used by any registry, and only the first
+		GDBASE_ECS_MAX_COMPONENTS fit in the mask. Types past the limit still work, but has() looks them up in their storage
+		and destroy() tries to remove every one of them.
+		Not thread safe: create entities and add or remove components from one thread at a time.
+		View::parallelEach may run while no other thread changes the registry.
+	*/
+	class EntityRegistry
+	{
+	public:
+		/*
+			EntityRegistry Constructor
+			@initialSize	Initial size of the entity pool rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
+		*/
+		explicit EntityRegistry(size_t initialSize = 1000) : entities_(initialSize) {}
+
+		//Returns a new entity with no components.
+		PoolIndex create()
+		{
+			auto entity = entities_.reserve();
+			entities_.at(entity).reset();
+			return entity;
+		}
+
+		//Removes all of entity's components and returns its id to the pool.
+		void destroy(PoolIndex entity)
+		{
+			auto& mask = entities_.at(entity);
+			for (size_t type = 0; type < storages_.size() && type < GDBASE_ECS_MAX_COMPONENTS && mask.any(); type++)
+			{
+				if (mask.test(type))
+				{
+					storages_[type]->remove(entity);
+					mask.reset(type);
+				}
+			}
+			for (size_t type = GDBASE_ECS_MAX_COMPONENTS; type < storages_.size(); type++)	//Types without a bit in the mask.
+			{
+				if (storages_[type] != nullptr)
+				{
+					storages_[type]->remove(entity);
+				}
+			}
+			entities_.release(entity);
+		}
+
+		bool isAlive(PoolIndex entity) { return entities_.isInUse(entity); }
+
+		//Constructs a component of type C for entity, replacing any it already has.
+		template <class C, class... Args>
+		C& emplace(PoolIndex entity, Args&&... args)
+		{
+			auto type = impl::componentTypeId<C>();
+			if (type < GDBASE_ECS_MAX_COMPONENTS)
+			{
+				entities_.at(entity).set(type);
+			}
+			return storage<C>().emplace(entity, std::forward<Args>(args)...);
+		}
+
+		template <class C>
+		void remove(PoolIndex entity)
+		{
+			auto type = impl::componentTypeId<C>();
+			if (type < GDBASE_ECS_MAX_COMPONENTS)
+			{
+				entities_.at(entity).reset(type);
+			}
+			storage<C>().remove(entity);
+		}
+
+		template <class C>
+		bool has(PoolIndex entity)
+		{
+			auto type = impl::componentTypeId<C>();
+			return type < GDBASE_ECS_MAX_COMPONENTS ? entities_.at(entity).test(type) : storage<C>().contains(entity);
+		}
+
+		//entity must have the component.
+		template <class C>
+		C& get(PoolIndex entity) { return storage<C>().get(entity); }
+
+		//Returns nullptr if entity does not have the component.
+		template <class C>
+		C* tryGet(PoolIndex entity) { return storage<C>().tryGet(entity); }
+
+		//Returns the storage of component type C, creating it on first use.
+		template <class C>
+		ComponentStorage<C>& storage()
+		{
+			auto type = impl::componentTypeId<C>();
+			if (type >= storages_.size())
+			{
+				storages_.resize(type + 1);
+			}
+			if (storages_[type] == nullptr)
+			{
+				storages_[type] = std::make_unique<ComponentStorage<C>>();
+			}
+			return static_cast<ComponentStorage<C>&>(*storages_[type]);
+		}
+
+		//Returns a view of the entities that have every component in Cs.
+		template <class... Cs>
+		View<Cs...> view() { return View<Cs...>(&storage<Cs>()...); }
+
+	private:
+		ObjectPool<std::bitset<GDBASE_ECS_MAX_COMPONENTS>> entities_;		//Which component types each entity has.
+		std::vector<std::unique_ptr<impl::ComponentStorageBase>> storages_;	//Indexed by component type id.
+	};
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "pch.h"
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+
+#include "ObjectPool.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		inline unsigned countTrailingZeros(uint64_t value);		//Index of the lowest set bit. value must not be 0.
+		inline unsigned popCount(uint64_t value);				//Number of set bits.
+	}
+
+	template <class Obj, size_t N>
+	class FixedObjectPool;		//Object pool with a fixed capacity and inline storage.
+
+	//Class definitions
+	inline unsigned impl::countTrailingZeros(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)value))	//Done in two halves so it also works in 32 bit builds.
+		{
+			return index;
+		}
+		_BitScanForward(&index, (unsigned long)(value >> 32));
+		return index + 32;
+#else
+		return (unsigned)__builtin_ctzll(value);
+#endif
+	}
+
+	inline unsigned impl::popCount(uint64_t value)
+	{
+#ifdef _MSC_VER
+		//__popcnt needs the POPCNT instruction, so count bits in parallel instead.
+		value = value - ((value >> 1) & 0x5555555555555555ULL);
+		value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+		value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (unsigned)((value * 0x0101010101010101ULL) >> 56);
+#else
+		return (unsigned)__builtin_popcountll(value);
+#endif
+	}
+
+	/*
+		FixedObjectPool
+		Thread safe object pool holding at most N objects, stored inside the pool itself.
+		Never allocates, so it can live on the stack or inside another object. Occupancy is a bitmap of N bits;
+		reserving sets a bit with a compare and swap and releasing clears it.
+		reserve() returns GDBASE_INVALID_ID when the pool is full instead of growing.
+	*/
+	template <class Obj, size_t N>
+	class FixedObjectPool
+	{
+		static_assert(N > 0, "FixedObjectPool must hold at least one object.");
+		static_assert(N < (size_t)GDBASE_INVALID_ID, "FixedObjectPool too large for GDBASE_INDEX_TYPE.");
+
+	public:
+		class Iterator;		//Iterates over the objects in use.
+
+		FixedObjectPool()
+		{
+			for (size_t word = 0; word < WORDS; word++)
+			{
+				inUse_[word].store(word == WORDS - 1 ? ~LAST_WORD_MASK : 0, std::memory_order_relaxed);	//Bits past N are permanently in use.
+			}
+		}
+
+		explicit FixedObjectPool(const Obj& defaultObject) : FixedObjectPool()
+		{
+			for (auto& object : objects_)
+			{
+				object = defaultObject;
+			}
+		}
+
+		FixedObjectPool(const FixedObjectPool&) = delete;
+		FixedObjectPool& operator=(const FixedObjectPool&) = delete;
+
+		static constexpr size_t capacity() { return N; }
+
+		bool isInUse(PoolIndex index) const { return index < N && (inUse_[index / 64].load() & bit(index)) != 0; }
+		Obj& at(PoolIndex index) { return objects_[index]; }
+
+		//Reserves one object. Returns the index to the object, or GDBASE_INVALID_ID if the pool is full.
+		PoolIndex reserve()
+		{
+			for (size_t word = 0; word < WORDS; word++)
+			{
+				auto bits = inUse_[word].load(std::memory_order_relaxed);
+				while (~bits != 0)
+				{
+					auto free = impl::countTrailingZeros(~bits);
+					if (inUse_[word].compare_exchange_weak(bits, bits | ((uint64_t)1 << free), std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						return (PoolIndex)(word * 64 + free);
+					}
+				}
+			}
+			return GDBASE_INVALID_ID;
+		}
+
+		/*
+			Reserves up to amount objects and writes their indices to ids.
+			Returns the number reserved, which is less than amount if the pool fills up.
+		*/
+		size_t reserveMultiple(PoolIndex* ids, size_t amount)
+		{
+			size_t reserved = 0;
+			for (size_t word = 0; word < WORDS && reserved < amount; word++)
+			{
+				auto bits = inUse_[word].load(std::memory_order_relaxed);
+				uint64_t taken;
+				do
+				{
+					//Take as many free bits of this word as are still needed, lowest first.
+					taken = 0;
+					auto free = ~bits;
+					for (auto needed = amount - reserved; free != 0 && needed > 0; needed--)
+					{
+						taken |= free & (~free + 1);
+						free &= free - 1;
+					}
+				} while (taken != 0 && !inUse_[word].compare_exchange_weak(bits, bits | taken, std::memory_order_acquire, std::memory_order_relaxed));
+
+				for (; taken != 0; taken &= taken - 1)
+				{
+					ids[reserved++] = (PoolIndex)(word * 64 + impl::countTrailingZeros(taken));
+				}
+			}
+			return reserved;
+		}
+
+		//Releases an object from use.
+		void release(PoolIndex index)
+		{
+			inUse_[index / 64].fetch_and(~bit(index), std::memory_order_release);
+		}
+
+		//Number of objects in use.
+		size_t size() const
+		{
+			size_t count = 0;
+			for (size_t word = 0; word < WORDS; word++)
+			{
+				count += impl::popCount(usedBits(word));
+			}
+			return count;
+		}
+
+		bool isEmpty() const { return size() == 0; }
+		bool isFull() const { return size() == N; }
+
+		//Calls fn(index, object) for every object in use, in index order.
+		template <class F>
+		void forEach(F&& fn)
+		{
+			for (size_t word = 0; word < WORDS; word++)
+			{
+				for (auto bits = usedBits(word); bits != 0; bits &= bits - 1)
+				{
+					auto index = (PoolIndex)(word * 64 + impl::countTrailingZeros(bits));
+					fn(index, objects_[index]);
+				}
+			}
+		}
+
+		Iterator begin() { return Iterator(this, 0); }
+		Iterator end() { return Iterator(this, N); }
+
+		/*
+			Iterator
+			Forward iterator over the objects in use. Objects reserved or released during iteration may or may not be visited.
+		*/
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Obj;
+			using difference_type = std::ptrdiff_t;
+			using pointer = Obj*;
+			using reference = Obj&;
+
+			Iterator(FixedObjectPool<Obj, N>* pool, size_t index) : pool_(pool), index_(pool->nextInUse(index)) {}
+
+			Obj& operator*() const { return pool_->objects_[index_]; }
+			Obj* operator->() const { return &pool_->objects_[index_]; }
+
+			Iterator& operator++()
+			{
+				index_ = pool_->nextInUse(index_ + 1);
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				auto previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const Iterator& other) const { return index_ == other.index_; }
+			bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+			PoolIndex index() const { return (PoolIndex)index_; }	//Index of the current object in the pool.
+
+		private:
+			FixedObjectPool<Obj, N>* pool_;
+			size_t index_;
+		};
+
+	private:
+		static constexpr size_t WORDS = (N + 63) / 64;
+		static constexpr uint64_t LAST_WORD_MASK = N % 64 == 0 ? ~(uint64_t)0 : ((uint64_t)1 << (N % 64)) - 1;	//Bits of the last word that are real objects.
+
+		Obj objects_[N];
+		std::atomic<uint64_t> inUse_[WORDS];
+
+		static uint64_t bit(size_t index) { return (uint64_t)1 << (index % 64); }
+
+		uint64_t usedBits(size_t word) const
+		{
+			auto bits = inUse_[word].load(std::memory_order_acquire);
+			return word == WORDS - 1 ? bits & LAST_WORD_MASK : bits;
+		}
+
+		//Returns the first index at or after from that is in use, or N if there is none.
+		size_t nextInUse(size_t from) const
+		{
+			for (auto word = from / 64; word < WORDS; word++)
+			{
+				auto bits = usedBits(word);
+				if (word == from / 64)
+				{
+					bits &= ~(uint64_t)0 << (from % 64);	//Skip indices before from.
+				}
+				if (bits != 0)
+				{
+					return word * 64 + impl::countTrailingZeros(bits);
+				}
+			}
+			return N;
+		}
+	};
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include "ObjectPool.h"
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		struct FrameCursor;				//A thread's bump position in one FrameObjectPool.
+
+		class FrameCursorCache;			//Per thread list of FrameCursors, one per pool the thread has reserved from.
+	}
+
+	template <class Obj>
+	class FrameObjectPool;				//Object pool whose objects are all released together at the end of a frame.
+
+	//Class definitions
+	struct impl::FrameCursor
+	{
+		uint64_t frame = 0;				//Frame the range below was claimed in. Stale once the pool's frame moves on.
+		PoolIndex position = 0;			//Next index to hand out.
+		PoolIndex end = 0;				//End of the claimed range.
+		std::weak_ptr<void> pool;		//Expires when the pool is destroyed.
+	};
+
+	/*
+		FrameCursorCache
+		Holds the cursors of the current thread. Cursors of destroyed pools are dropped the next time the thread adds a cursor,
+		so the cache only grows with the number of pools alive at once. Pool ids are never reused.
+	*/
+	class impl::FrameCursorCache
+	{
+	public:
+		FrameCursor& find(uint64_t poolId, const std::shared_ptr<void>& pool)
+		{
+			if (lastId_ == poolId)
+			{
+				return *lastCursor_;
+			}
+
+			lastId_ = poolId;
+			for (auto& entry : cursors_)
+			{
+				if (entry.first == poolId)
+				{
+					lastCursor_ = &entry.second;
+					return *lastCursor_;
+				}
+			}
+
+			//Callers only hold a cursor until the next find, so moving the others is fine.
+			cursors_.erase(std::remove_if(cursors_.begin(), cursors_.end(), [](auto& entry) { return entry.second.pool.expired(); }), cursors_.end());
+			cursors_.emplace_back(poolId, FrameCursor());
+			lastCursor_ = &cursors_.back().second;
+			lastCursor_->pool = pool;
+			return *lastCursor_;
+		}
+
+		size_t size() const { return cursors_.size(); }
+
+		static FrameCursorCache& current()
+		{
+			static thread_local FrameCursorCache cache;
+			return cache;
+		}
+
+	private:
+		std::vector<std::pair<uint64_t, FrameCursor>> cursors_;
+		uint64_t lastId_ = 0;				//Pool ids start at 1.
+		FrameCursor* lastCursor_ = nullptr;
+	};
+
+	/*
+		FrameObjectPool
+		Object pool for objects that only live for one frame, such as query results and temporary messages.
+		Objects are never released one at a time: releaseAll() ends the frame and makes every object available again in O(1).
+		Each thread claims whole blocks of GDBASE_OBJECTPOOL_BLOCK_SIZE objects and hands them out with a bump pointer,
+		so reserving only touches shared state once per block.
+		Blocks are kept between frames. Indices returned during a frame are only valid until the next releaseAll(),
+		which must not run while other threads are reserving.
+	*/
+	template <class Obj>
+	class FrameObjectPool
+	{
+	public:
+		/*
+			FrameObjectPool Constructor
+			@defaultObject	Value objects are reset to when releaseAll() is asked to reset them.
+			@initialSize	Number of objects allocated up front rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
+		*/
+		explicit FrameObjectPool(const Obj& defaultObject = Obj(), size_t initialSize = 1000)
+			: defaultObject_(defaultObject), nBlocks_(0), nextBlock_(0), frame_(1), lifetime_(std::make_shared<char>())
+		{
+			static std::atomic<uint64_t> nextId(1);
+			id_ = nextId++;
+
+			poolObjects_ = new Obj* [GDBASE_OBJECTPOOL_MAX_BLOCKS];
+			addBlocks((initialSize + GDBASE_OBJECTPOOL_BLOCK_SIZE - 1) / GDBASE_OBJECTPOOL_BLOCK_SIZE);
+		}
+
+		~FrameObjectPool()
+		{
+			for (size_t block = 0; block < nBlocks_.load(); block++)
+			{
+				delete[] poolObjects_[block];
+			}
+			delete[] poolObjects_;
+		}
+
+		FrameObjectPool(const FrameObjectPool&) = delete;
+		FrameObjectPool& operator=(const FrameObjectPool&) = delete;
+
+		Obj& at(PoolIndex index) { return poolObjects_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+
+		/*
+			Reserves one object for the rest of the frame. Returns the index to the object,
+			or GDBASE_INVALID_ID if GDBASE_OBJECTPOOL_MAX_BLOCKS blocks are already claimed this frame.
+		*/
+		PoolIndex reserve()
+		{
+			auto cursor = localCursor(1);
+			return cursor != nullptr ? cursor->position++ : GDBASE_INVALID_ID;
+		}
+
+		/*
+			Reserves amount consecutive objects for the rest of the frame and returns the index of the first.
+			Returns GDBASE_INVALID_ID if amount is larger than a block or GDBASE_OBJECTPOOL_MAX_BLOCKS blocks are already claimed this frame.
+			@amount	Number of objects. At most GDBASE_OBJECTPOOL_BLOCK_SIZE.
+		*/
+		PoolIndex reserveMultiple(size_t amount)
+		{
+			if (amount > GDBASE_OBJECTPOOL_BLOCK_SIZE)
+			{
+				return GDBASE_INVALID_ID;
+			}
+
+			auto cursor = localCursor(amount);
+			if (cursor == nullptr)
+			{
+				return GDBASE_INVALID_ID;
+			}
+			auto first = cursor->position;
+			cursor->position += (PoolIndex)amount;
+			return first;
+		}
+
+		/*
+			Releases every object reserved this frame.
+			@resetObjects	Also assigns the default object to every object handed out, freeing whatever they hold.
+							Without it objects keep their values until they are reused.
+		*/
+		void releaseAll(bool resetObjects = false)
+		{
+			if (resetObjects)
+			{
+				for (size_t block = 0; block < nextBlock_.load(); block++)
+				{
+					for (size_t i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+					{
+						poolObjects_[block][i] = defaultObject_;
+					}
+				}
+			}
+
+			nextBlock_.store(0);
+			frame_++;		//Invalidates every thread's cursor.
+		}
+
+		//Ends the current frame. Same as releaseAll().
+		void endFrame(bool resetObjects = false) { releaseAll(resetObjects); }
+
+		//Number of frames ended so far.
+		uint64_t getFrame() { return frame_.load() - 1; }
+
+		//Number of objects allocated.
+		size_t getCapacity() { return nBlocks_.load() * GDBASE_OBJECTPOOL_BLOCK_SIZE; }
+
+		//Number of blocks claimed by threads this frame.
+		size_t getBlocksInUse() { return nextBlock_.load(); }
+
+	protected:
+		Obj** poolObjects_;
+		Obj defaultObject_;
+		std::mutex capacityLock_;
+		std::atomic_size_t nBlocks_;			//Number of blocks allocated.
+		std::atomic_size_t nextBlock_;			//Next block to hand to a thread this frame.
+		std::atomic<uint64_t> frame_;
+		uint64_t id_;							//Identifies this pool in each thread's FrameCursorCache.
+		std::shared_ptr<void> lifetime_;		//Only owned by the pool, so the cursors' weak references expire with it.
+
+		/*
+			Returns the calling thread's cursor with room for amount objects, claiming a new block if needed.
+			Returns nullptr if every one of the GDBASE_OBJECTPOOL_MAX_BLOCKS blocks is claimed.
+		*/
+		impl::FrameCursor* localCursor(size_t amount)
+		{
+			auto& cursor = impl::FrameCursorCache::current().find(id_, lifetime_);
+			auto frame = frame_.load(std::memory_order_relaxed);
+			if (cursor.frame == frame && cursor.end - cursor.position >= amount)
+			{
+				return &cursor;
+			}
+
+			//Anything left in the current block is wasted until the end of the frame.
+			auto block = nextBlock_.load();
+			do
+			{
+				if (block >= GDBASE_OBJECTPOOL_MAX_BLOCKS)
+				{
+					return nullptr;
+				}
+			} while (!nextBlock_.compare_exchange_weak(block, block + 1));
+
+			if (block >= nBlocks_.load())
+			{
+				addBlocks(block + 1);
+			}
+			cursor.frame = frame;
+			cursor.position = (PoolIndex)(block * GDBASE_OBJECTPOOL_BLOCK_SIZE);
+			cursor.end = cursor.position + GDBASE_OBJECTPOOL_BLOCK_SIZE;
+			return &cursor;
+		}
+
+		//Allocates blocks until there are at least nBlocks.
+		void addBlocks(size_t nBlocks)
+		{
+			std::lock_guard<std::mutex> capacityGuard(capacityLock_);
+			for (auto block = nBlocks_.load(); block < nBlocks; block++)
+			{
+				poolObjects_[block] = new Obj[GDBASE_OBJECTPOOL_BLOCK_SIZE];
+				for (size_t i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+				{
+					poolObjects_[block][i] = defaultObject_;
+				}
+				nBlocks_.store(block + 1);
+			}
+		}
+	};
+};
@@ -0,0 +1,562 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include "ObjectPool.h"
+#include "FixedObjectPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GDBASE_INDEXMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#define GDBASE_INDEXMAP_BATCH_SIZE 16		//Number of keys findMultiple() hashes and prefetches before probing any of them.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		struct GroupMask;				//Set of positions within a ControlGroup.
+
+		class ControlGroup;				//Control bytes of a group of consecutive slots, probed together.
+
+		template <class Key, bool concurrent>
+		struct IndexMapSlot;			//Key and pool index stored in one slot of an IndexMap.
+
+		template <class Key, bool concurrent>
+		struct IndexMapTable;			//Control bytes and slots of an IndexMap.
+
+		inline uint64_t loadControl(const std::atomic<uint64_t>* control, size_t position);	//8 control bytes starting at position.
+
+		inline uint64_t mixHash(uint64_t hash);		//Spreads the bits of a hash so both halves of it are usable.
+
+		inline void prefetch(const void* address);
+	}
+
+	template <class Key = uint64_t, class Hash = std::hash<Key>, bool concurrent = false>
+	class IndexMap;					//Open addressing hash map from keys to pool indices.
+
+	template <class Key = uint64_t, class Hash = std::hash<Key>>
+	using ConcurrentIndexMap = IndexMap<Key, Hash, true>;		//Lock free lookups, one writer at a time.
+
+	//Class definitions
+	struct impl::GroupMask
+	{
+#ifdef GDBASE_INDEXMAP_SSE2
+		static constexpr unsigned SHIFT = 0;		//One bit per slot.
+#else
+		static constexpr unsigned SHIFT = 3;		//High bit of each byte.
+#endif
+		uint64_t bits;
+
+		explicit operator bool() const { return bits != 0; }
+		size_t lowest() const { return countTrailingZeros(bits) >> SHIFT; }
+		void clearLowest() { bits &= bits - 1; }
+	};
+
+	/*
+		ControlGroup
+		Each slot has a control byte: EMPTY, DELETED, or the low 7 bits of its key's hash when full.
+		A group compares all of its control bytes with one SSE2 instruction, or 8 at a time in a 64 bit word without SSE2.
+		Control bytes are packed into atomic 64 bit words, byte i of a word in bits 8i to 8i + 7, and a group is loaded
+		with relaxed word loads so concurrent readers never race the writer.
+	*/
+	class impl::ControlGroup
+	{
+	public:
+		static constexpr int8_t EMPTY = -128;
+		static constexpr int8_t DELETED = -2;
+#ifdef GDBASE_INDEXMAP_SSE2
+		static constexpr size_t WIDTH = 16;
+
+		ControlGroup(const std::atomic<uint64_t>* control, size_t position) : control_(_mm_set_epi64x((long long)loadControl(control, position + 8), (long long)loadControl(control, position))) {}
+
+		GroupMask match(int8_t h2) const { return GroupMask{ (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), control_)) }; }
+		GroupMask matchEmpty() const { return GroupMask{ (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(EMPTY), control_)) }; }
+		GroupMask matchEmptyOrDeleted() const { return GroupMask{ (uint64_t)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), control_)) }; }
+
+	private:
+		__m128i control_;
+#else
+		static constexpr size_t WIDTH = 8;
+
+		ControlGroup(const std::atomic<uint64_t>* control, size_t position) : control_(loadControl(control, position)) {}
+
+		//May report a full slot right after a real match; callers compare keys anyway.
+		GroupMask match(int8_t h2) const
+		{
+			auto x = control_ ^ (LSBS * (uint8_t)h2);
+			return GroupMask{ (x - LSBS) & ~x & MSBS };
+		}
+		GroupMask matchEmpty() const { return GroupMask{ control_ & (~control_ << 6) & MSBS }; }
+		GroupMask matchEmptyOrDeleted() const { return GroupMask{ control_ & (~control_ << 7) & MSBS }; }
+
+	private:
+		static constexpr uint64_t LSBS = 0x0101010101010101ULL;
+		static constexpr uint64_t MSBS = 0x8080808080808080ULL;
+
+		uint64_t control_;		//Byte i of the group in bits 8i to 8i + 7.
+#endif
+	};
+
+	template <class Key, bool concurrent>
+	struct impl::IndexMapSlot
+	{
+		Key key;
+		PoolIndex index;
+
+		const Key& getKey() const { return key; }
+		PoolIndex getIndex() const { return index; }
+		void setKey(const Key& newKey) { key = newKey; }
+		void setIndex(PoolIndex newIndex) { index = newIndex; }
+	};
+
+	//Read while being written, so the key is copied in and out of relaxed atomic 64 bit words.
+	template <class Key>
+	struct impl::IndexMapSlot<Key, true>
+	{
+		static constexpr size_t WORDS = (sizeof(Key) + 7) / 8;
+
+		std::atomic<uint64_t> key[WORDS];
+		std::atomic<PoolIndex> index;
+
+		Key getKey() const
+		{
+			uint64_t words[WORDS];
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				words[i] = key[i].load(std::memory_order_relaxed);
+			}
+			Key value;
+			std::memcpy(&value, words, sizeof(Key));
+			return value;
+		}
+
+		PoolIndex getIndex() const { return index.load(std::memory_order_relaxed); }
+
+		void setKey(const Key& newKey)
+		{
+			uint64_t words[WORDS] = {};
+			std::memcpy(words, &newKey, sizeof(Key));
+			for (size_t i = 0; i < WORDS; i++)
+			{
+				key[i].store(words[i], std::memory_order_relaxed);
+			}
+		}
+
+		void setIndex(PoolIndex newIndex) { index.store(newIndex, std::memory_order_relaxed); }
+	};
+
+	/*
+		IndexMapTable
+		capacity is a power of 2 of at least one group. The first group's control bytes are repeated after the last slot
+		so a group can be loaded starting at any slot.
+	*/
+	template <class Key, bool concurrent>
+	struct impl::IndexMapTable
+	{
+		static constexpr uint64_t EMPTY_WORD = 0x0101010101010101ULL * (uint8_t)ControlGroup::EMPTY;
+
+		size_t capacity;
+		std::unique_ptr<std::atomic<uint64_t>[]> control;		//(capacity + ControlGroup::WIDTH) / 8 words of control bytes.
+		std::unique_ptr<IndexMapSlot<Key, concurrent>[]> slots;
+
+		explicit IndexMapTable(size_t capacity) : capacity(capacity), control(new std::atomic<uint64_t>[controlWords(capacity)]), slots(new IndexMapSlot<Key, concurrent>[capacity])
+		{
+			clearControl();
+		}
+
+		static size_t controlWords(size_t capacity) { return (capacity + ControlGroup::WIDTH) / 8; }
+
+		int8_t getControl(size_t position) const { return (int8_t)(control[position / 8].load(std::memory_order_relaxed) >> (position % 8 * 8)); }
+
+		//Only one thread at a time may change control bytes.
+		void setControl(size_t position, int8_t value)
+		{
+			storeControl(position, value);
+			if (position < ControlGroup::WIDTH)
+			{
+				storeControl(capacity + position, value);
+			}
+		}
+
+		void clearControl()
+		{
+			for (size_t word = 0; word < controlWords(capacity); word++)
+			{
+				control[word].store(EMPTY_WORD, std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		void storeControl(size_t position, int8_t value)
+		{
+			auto& word = control[position / 8];
+			auto shift = position % 8 * 8;
+			word.store((word.load(std::memory_order_relaxed) & ~((uint64_t)0xFF << shift)) | ((uint64_t)(uint8_t)value << shift), std::memory_order_relaxed);
+		}
+	};
+
+	inline uint64_t impl::loadControl(const std::atomic<uint64_t>* control, size_t position)
+	{
+		auto shift = position % 8 * 8;
+		auto low = control[position / 8].load(std::memory_order_relaxed);
+		return shift == 0 ? low : (low >> shift) | (control[position / 8 + 1].load(std::memory_order_relaxed) << (64 - shift));
+	}
+
+	inline uint64_t impl::mixHash(uint64_t hash)
+	{
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDULL;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ULL;
+		return hash ^ (hash >> 33);
+	}
+
+	inline void impl::prefetch(const void* address)
+	{
+#ifdef GDBASE_INDEXMAP_SSE2
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+		__builtin_prefetch(address);
+#else
+		(void)address;
+#endif
+	}
+
+	/*
+		IndexMap
+		Flat hash map from keys, such as network ids, GUIDs or asset hashes, to pool indices.
+		Slots are stored in one array next to an array of control bytes holding 7 bits of each key's hash, and lookups
+		compare a whole group of control bytes at once, so a lookup usually touches one group of control bytes and one slot.
+		Erased slots are marked DELETED and reused by later inserts; the table is rebuilt when empty slots run out.
+		findMultiple() looks up a batch of keys, prefetching all of their groups before probing any of them.
+
+		With concurrent set, any number of threads may call find(), contains() and findMultiple() while one thread at a time
+		(serialized by a mutex) changes the map. Readers take no lock: they retry if a write happened while they were reading.
+		Tables replaced when the map grows are kept until reclaim() is called at a point where no thread is reading,
+		such as between frames. Key must then be trivially copyable.
+	*/
+	template <class Key, class Hash, bool concurrent>
+	class IndexMap
+	{
+		static_assert(!concurrent || std::is_trivially_copyable_v<Key>, "ConcurrentIndexMap keys are read while being written and must be trivially copyable.");
+
+	public:
+		/*
+			IndexMap Constructor
+			@initialCapacity	Number of keys the map can hold before it grows.
+		*/
+		explicit IndexMap(size_t initialCapacity = 16, const Hash& hash = Hash()) : hash_(hash), size_(0), sequence_(0)
+		{
+			auto table = std::make_unique<impl::IndexMapTable<Key, concurrent>>(capacityFor(initialCapacity));
+			growthLeft_ = maxLoad(table->capacity);
+			table_.store(table.get(), std::memory_order_relaxed);
+			tables_.push_back(std::move(table));
+		}
+
+		IndexMap(const IndexMap&) = delete;
+		IndexMap& operator=(const IndexMap&) = delete;
+
+		size_t size() const { return size_; }
+		bool isEmpty() const { return size_ == 0; }
+		size_t capacity() const { return table_.load(std::memory_order_relaxed)->capacity; }
+
+		//Returns the index stored under key, or GDBASE_INVALID_ID if there is none.
+		PoolIndex find(const Key& key) const
+		{
+			auto hash = hashOf(key);
+			if constexpr (!concurrent)
+			{
+				return findIn(*table_.load(std::memory_order_relaxed), key, hash);
+			}
+			else
+			{
+				PoolIndex index;
+				uint64_t sequence;
+				do
+				{
+					sequence = readBegin();
+					index = findIn(*table_.load(std::memory_order_acquire), key, hash);
+				} while (!readValidate(sequence));
+				return index;
+			}
+		}
+
+		bool contains(const Key& key) const { return find(key) != GDBASE_INVALID_ID; }
+
+		//Looks up count keys, writing each one's index, or GDBASE_INVALID_ID, to indices.
+		void findMultiple(const Key* keys, PoolIndex* indices, size_t count) const
+		{
+			for (size_t first = 0; first < count; first += GDBASE_INDEXMAP_BATCH_SIZE)
+			{
+				auto batch = count - first < GDBASE_INDEXMAP_BATCH_SIZE ? count - first : GDBASE_INDEXMAP_BATCH_SIZE;
+				uint64_t hashes[GDBASE_INDEXMAP_BATCH_SIZE];
+				for (size_t i = 0; i < batch; i++)
+				{
+					hashes[i] = hashOf(keys[first + i]);
+				}
+
+				uint64_t sequence = 0;
+				do
+				{
+					if constexpr (concurrent)
+					{
+						sequence = readBegin();
+					}
+					auto& table = *table_.load(std::memory_order_acquire);
+					for (size_t i = 0; i < batch; i++)
+					{
+						auto position = (hashes[i] >> 7) & (table.capacity - 1);
+						impl::prefetch(&table.control[position / 8]);
+						impl::prefetch(&table.slots[position]);
+					}
+					for (size_t i = 0; i < batch; i++)
+					{
+						indices[first + i] = findIn(table, keys[first + i], hashes[i]);
+					}
+				} while (concurrent && !readValidate(sequence));
+			}
+		}
+
+		//Stores index under key. Returns false and leaves the map unchanged if key is already present.
+		bool insert(const Key& key, PoolIndex index) { return store(key, index, false); }
+
+		//Stores index under key, replacing any index already stored under it.
+		void insertOrAssign(const Key& key, PoolIndex index) { store(key, index, true); }
+
+		//Removes key. Returns false if it was not present.
+		bool erase(const Key& key)
+		{
+			auto guard = writeGuard();
+			auto hash = hashOf(key);
+			auto& table = *table_.load(std::memory_order_relaxed);
+			auto position = positionOf(table, key, hash);
+			if (position == NOT_FOUND)
+			{
+				return false;
+			}
+
+			writeBegin();
+			table.setControl(position, impl::ControlGroup::DELETED);
+			writeEnd();
+			size_--;
+			return true;
+		}
+
+		void clear()
+		{
+			auto guard = writeGuard();
+			auto& table = *table_.load(std::memory_order_relaxed);
+			writeBegin();
+			table.clearControl();
+			writeEnd();
+			size_ = 0;
+			growthLeft_ = maxLoad(table.capacity);
+		}
+
+		//Grows the map so it can hold at least count keys without growing again.
+		void reserve(size_t count)
+		{
+			auto guard = writeGuard();
+			if (count > size_ + growthLeft_)
+			{
+				rehash(capacityFor(count));
+			}
+		}
+
+		//Frees tables replaced by growth. In concurrent mode no thread may be reading the map.
+		void reclaim()
+		{
+			auto guard = writeGuard();
+			tables_.erase(tables_.begin(), tables_.end() - 1);
+		}
+
+	private:
+		static constexpr size_t NOT_FOUND = (size_t)-1;
+
+		Hash hash_;
+		std::atomic<impl::IndexMapTable<Key, concurrent>*> table_;				//Current table.
+		std::vector<std::unique_ptr<impl::IndexMapTable<Key, concurrent>>> tables_;	//Current table last, preceded by replaced ones readers may still use.
+		size_t size_;
+		size_t growthLeft_;		//Number of empty slots that may still be filled before the table is rebuilt.
+		std::mutex writeLock_;
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic<uint64_t> sequence_;	//Odd while a write is in progress.
+
+		static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+		static size_t capacityFor(size_t count)
+		{
+			auto capacity = impl::ControlGroup::WIDTH;
+			while (maxLoad(capacity) < count)
+			{
+				capacity <<= 1;
+			}
+			return capacity;
+		}
+
+		uint64_t hashOf(const Key& key) const { return impl::mixHash((uint64_t)hash_(key)); }
+
+		std::unique_lock<std::mutex> writeGuard() { return concurrent ? std::unique_lock<std::mutex>(writeLock_) : std::unique_lock<std::mutex>(); }
+
+		void writeBegin()
+		{
+			if constexpr (concurrent)
+			{
+				sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+			}
+		}
+
+		void writeEnd()
+		{
+			if constexpr (concurrent)
+			{
+				sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			}
+		}
+
+		uint64_t readBegin() const
+		{
+			uint64_t sequence;
+			while ((sequence = sequence_.load(std::memory_order_acquire)) & 1)
+			{
+				std::this_thread::yield();
+			}
+			return sequence;
+		}
+
+		bool readValidate(uint64_t sequence) const
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return sequence_.load(std::memory_order_relaxed) == sequence;
+		}
+
+		//Slot holding key, or NOT_FOUND.
+		size_t positionOf(const impl::IndexMapTable<Key, concurrent>& table, const Key& key, uint64_t hash) const
+		{
+			auto mask = table.capacity - 1;
+			auto position = (size_t)(hash >> 7) & mask;
+			auto h2 = (int8_t)(hash & 0x7F);
+
+			//Probe groups at triangular offsets, which visits every group once. Bounded so torn reads can not loop forever.
+			for (size_t probe = 1; probe <= table.capacity / impl::ControlGroup::WIDTH; probe++)
+			{
+				impl::ControlGroup group(table.control.get(), position);
+				for (auto match = group.match(h2); match; match.clearLowest())
+				{
+					auto candidate = (position + match.lowest()) & mask;
+					if (table.slots[candidate].getKey() == key)
+					{
+						return candidate;
+					}
+				}
+				if (group.matchEmpty())
+				{
+					return NOT_FOUND;
+				}
+				position = (position + probe * impl::ControlGroup::WIDTH) & mask;
+			}
+			return NOT_FOUND;
+		}
+
+		PoolIndex findIn(const impl::IndexMapTable<Key, concurrent>& table, const Key& key, uint64_t hash) const
+		{
+			auto position = positionOf(table, key, hash);
+			return position != NOT_FOUND ? table.slots[position].getIndex() : GDBASE_INVALID_ID;
+		}
+
+		//First empty or deleted slot on key's probe sequence. The table must have one.
+		static size_t freePosition(const impl::IndexMapTable<Key, concurrent>& table, uint64_t hash)
+		{
+			auto mask = table.capacity - 1;
+			auto position = (size_t)(hash >> 7) & mask;
+			for (size_t probe = 1;; probe++)
+			{
+				auto free = impl::ControlGroup(table.control.get(), position).matchEmptyOrDeleted();
+				if (free)
+				{
+					return (position + free.lowest()) & mask;
+				}
+				position = (position + probe * impl::ControlGroup::WIDTH) & mask;
+			}
+		}
+
+		bool store(const Key& key, PoolIndex index, bool assign)
+		{
+			auto guard = writeGuard();
+			auto hash = hashOf(key);
+			auto table = table_.load(std::memory_order_relaxed);
+			auto position = positionOf(*table, key, hash);
+			if (position != NOT_FOUND)
+			{
+				if (assign)
+				{
+					writeBegin();
+					table->slots[position].setIndex(index);
+					writeEnd();
+				}
+				return false;
+			}
+
+			position = freePosition(*table, hash);
+			if (growthLeft_ == 0 && table->getControl(position) == impl::ControlGroup::EMPTY)
+			{
+				//Rebuild at the same size if deleted slots are what used the table up, otherwise double it.
+				rehash(size_ < maxLoad(table->capacity) / 2 ? table->capacity : table->capacity * 2);
+				table = table_.load(std::memory_order_relaxed);
+				position = freePosition(*table, hash);
+			}
+			if (table->getControl(position) == impl::ControlGroup::EMPTY)
+			{
+				growthLeft_--;
+			}
+
+			writeBegin();
+			table->slots[position].setKey(key);
+			table->slots[position].setIndex(index);
+			table->setControl(position, (int8_t)(hash & 0x7F));
+			writeEnd();
+			size_++;
+			return true;
+		}
+
+		//Moves every key to a new table of the given capacity, dropping deleted slots.
+		void rehash(size_t capacity)
+		{
+			auto& old = *table_.load(std::memory_order_relaxed);
+			auto table = std::make_unique<impl::IndexMapTable<Key, concurrent>>(capacity);
+			for (size_t i = 0; i < old.capacity; i++)
+			{
+				if (old.getControl(i) >= 0)
+				{
+					auto hash = hashOf(old.slots[i].getKey());
+					auto position = freePosition(*table, hash);
+					table->slots[position].setKey(old.slots[i].getKey());
+					table->slots[position].setIndex(old.slots[i].getIndex());
+					table->setControl(position, (int8_t)(hash & 0x7F));
+				}
+			}
+			growthLeft_ = maxLoad(capacity) - size_;
+
+			writeBegin();
+			table_.store(table.get(), std::memory_order_release);
+			writeEnd();
+			if (!concurrent)
+			{
+				tables_.clear();	//Nobody else can be reading the old table.
+			}
+			tables_.push_back(std::move(table));
+		}
+	};
+};
@@ -0,0 +1,462 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+
+#include "ObjectPool.h"
+#include "MessageQueue.h"
+
+#define GDBASE_JOBSCHEDULER_MAX_JOBS 4096		//Default number of jobs that may exist at once. Creating more waits for jobs to finish.
+#define GDBASE_JOBSCHEDULER_DEQUE_SIZE 4096		//Capacity of each worker's deque. Rounded up to a power of 2.
+#define GDBASE_JOB_DATA_SIZE 64					//Bytes available for a job's callable.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		struct Job;						//Pooled job record.
+
+		class WorkStealingDeque;		//Chase-Lev deque of job indices.
+	}
+
+	struct JobHandle;					//Refers to a job until it finishes.
+
+	class JobScheduler;					//Fixed pool of worker threads that execute jobs.
+
+	//Class definitions
+	struct JobHandle
+	{
+		PoolIndex index = GDBASE_INVALID_ID;
+		uint32_t generation = 0;		//Job records are reused; a handle is finished once its record's generation moves on.
+
+		bool isValid() const { return index != GDBASE_INVALID_ID; }
+	};
+
+	struct alignas(GDBASE_CACHE_LINE_SIZE) impl::Job
+	{
+		void (*invoke)(void*) = nullptr;
+		void (*destroy)(void*) = nullptr;
+		std::atomic<int32_t> unfinished{ 0 };		//1 for the job itself plus 1 per unfinished child.
+		std::atomic<uint32_t> generation{ 0 };
+		PoolIndex parent = GDBASE_INVALID_ID;
+		alignas(std::max_align_t) unsigned char data[GDBASE_JOB_DATA_SIZE];	//Storage for the callable.
+	};
+
+	/*
+		WorkStealingDeque
+		Fixed size Chase-Lev deque. The owning worker pushes and pops at the bottom without contention;
+		other threads steal from the top.
+	*/
+	class impl::WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(size_t capacity) : top_(0), bottom_(0)
+		{
+			capacity_ = 2;
+			while (capacity_ < capacity)
+			{
+				capacity_ <<= 1;
+			}
+			buffer_ = std::make_unique<std::atomic<PoolIndex>[]>(capacity_);
+		}
+
+		//Owner only. Returns false if the deque is full.
+		bool push(PoolIndex value)
+		{
+			auto bottom = bottom_.load(std::memory_order_relaxed);
+			auto top = top_.load(std::memory_order_acquire);
+			if (bottom - top >= (int64_t)capacity_)
+			{
+				return false;
+			}
+			buffer_[bottom & (capacity_ - 1)].store(value, std::memory_order_relaxed);
+			bottom_.store(bottom + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Owner only. Takes the most recently pushed value.
+		bool pop(PoolIndex& value)
+		{
+			auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+			bottom_.store(bottom, std::memory_order_seq_cst);		//Must be visible to thieves before top is read.
+			auto top = top_.load(std::memory_order_seq_cst);
+
+			if (top > bottom)	//Empty.
+			{
+				bottom_.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			value = buffer_[bottom & (capacity_ - 1)].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				//Last value; race thieves for it.
+				auto won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				bottom_.store(bottom + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		//Any thread. Takes the least recently pushed value.
+		bool steal(PoolIndex& value)
+		{
+			auto top = top_.load(std::memory_order_seq_cst);
+			auto bottom = bottom_.load(std::memory_order_seq_cst);
+			if (top >= bottom)
+			{
+				return false;
+			}
+
+			value = buffer_[top & (capacity_ - 1)].load(std::memory_order_relaxed);
+			return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+	private:
+		std::unique_ptr<std::atomic<PoolIndex>[]> buffer_;
+		size_t capacity_;
+
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic<int64_t> top_;		//Steal end.
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic<int64_t> bottom_;	//Owner end.
+	};
+
+	/*
+		JobScheduler
+		Runs jobs on a fixed set of worker threads. Each worker has its own work stealing deque; threads that are not workers
+		submit through a shared queue. Job records come from an ObjectPool, so scheduling a job does not allocate.
+
+		A job may be given a parent when it is created; the parent is not finished until all of its children are.
+		wait() executes other jobs while it waits, so it may be called from inside a job.
+	*/
+	class JobScheduler
+	{
+	public:
+		/*
+			JobScheduler Constructor
+			@nWorkers	Number of worker threads. Defaults to one less than the number of hardware threads, since the caller helps in wait().
+			@maxJobs	Number of jobs that may exist at once.
+		*/
+		explicit JobScheduler(size_t nWorkers = defaultWorkerCount(), size_t maxJobs = GDBASE_JOBSCHEDULER_MAX_JOBS)
+			: pool_(maxJobs), injected_(maxJobs), maxJobs_(maxJobs), liveJobs_(0), running_(true), sleeping_(0)
+		{
+			nWorkers = nWorkers > 0 ? nWorkers : 1;
+			for (size_t i = 0; i < nWorkers; i++)
+			{
+				deques_.push_back(std::make_unique<impl::WorkStealingDeque>(GDBASE_JOBSCHEDULER_DEQUE_SIZE));
+			}
+			for (size_t i = 0; i < nWorkers; i++)
+			{
+				workers_.emplace_back(&JobScheduler::workerLoop, this, i);
+			}
+		}
+
+		//Stops the workers. Jobs that have not started are not run; wait for them first.
+		~JobScheduler()
+		{
+			{
+				std::lock_guard<std::mutex> guard(sleepLock_);
+				running_.store(false);
+			}
+			wake_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		/*
+			Creates a job that calls fn. The job does not start until passed to run().
+			If maxJobs jobs already exist, executes other jobs until one finishes.
+			@parent	Optional job that will not finish until this one has. Must not have finished yet.
+		*/
+		template <class F>
+		JobHandle create(F&& fn, JobHandle parent = JobHandle())
+		{
+			JobHandle job;
+			while (!tryCreate(std::forward<F>(fn), parent, job))
+			{
+				if (!executeOne())
+				{
+					std::this_thread::yield();
+				}
+			}
+			return job;
+		}
+
+		//Creates a job like create(), but returns false instead of waiting if maxJobs jobs already exist.
+		template <class F>
+		bool tryCreate(F&& fn, JobHandle parent, JobHandle& job)
+		{
+			using Callable = std::decay_t<F>;
+			static_assert(sizeof(Callable) <= GDBASE_JOB_DATA_SIZE, "Job callable too large. Capture by reference or pointer.");
+			static_assert(alignof(Callable) <= alignof(std::max_align_t), "Job callable over-aligned.");
+
+			//Keep the number of jobs within the pool's capacity so it never grows while in use.
+			if (liveJobs_.fetch_add(1) >= maxJobs_)
+			{
+				liveJobs_--;
+				return false;
+			}
+
+			auto index = pool_.reserve();
+			auto& record = pool_.at(index);
+			new (record.data) Callable(std::forward<F>(fn));
+			record.invoke = [](void* data) { (*static_cast<Callable*>(data))(); };
+			record.destroy = [](void* data) { static_cast<Callable*>(data)->~Callable(); };
+			record.unfinished.store(1);
+			record.parent = parent.index;
+			if (parent.isValid())
+			{
+				pool_.at(parent.index).unfinished++;
+			}
+			job = JobHandle{ index, record.generation.load() };
+			return true;
+		}
+
+		//Queues a created job for execution.
+		void run(JobHandle job)
+		{
+			auto worker = currentWorker();
+			auto queued = worker != nullptr ? deques_[worker->index]->push(job.index) : injected_.push(job.index);
+			if (!queued)
+			{
+				execute(job.index);		//Queue full; run it here instead.
+				return;
+			}
+
+			if (sleeping_.load() > 0)
+			{
+				wake_.notify_one();
+			}
+		}
+
+		//Creates and runs a job.
+		template <class F>
+		JobHandle schedule(F&& fn, JobHandle parent = JobHandle())
+		{
+			auto job = create(std::forward<F>(fn), parent);
+			run(job);
+			return job;
+		}
+
+		bool isFinished(JobHandle job) { return pool_.at(job.index).generation.load() != job.generation; }
+
+		//Executes other jobs until job is finished.
+		void wait(JobHandle job)
+		{
+			while (!isFinished(job))
+			{
+				if (!executeOne())
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/*
+			Calls fn(i) for every i in [begin, end) across the workers and returns once all calls are done.
+			Parts of the range are run on the calling thread when no job records are free, so nested calls can not deadlock.
+			@grain	Number of indices handled by one job. 0 picks a size that gives each thread a few jobs.
+		*/
+		template <class F>
+		void parallelFor(size_t begin, size_t end, F&& fn, size_t grain = 0)
+		{
+			if (begin >= end)
+			{
+				return;
+			}
+			if (grain == 0)
+			{
+				grain = std::max<size_t>(1, (end - begin) / ((workers_.size() + 1) * 4));
+			}
+
+			JobHandle root;
+			if (!tryCreate([]() {}, JobHandle(), root))
+			{
+				for (auto i = begin; i < end; i++)
+				{
+					fn(i);
+				}
+				return;
+			}
+			splitRange(root, begin, end, grain, &fn);
+			run(root);
+			wait(root);
+		}
+
+		size_t workerCount() const { return workers_.size(); }
+
+		static size_t defaultWorkerCount()
+		{
+			auto threads = std::thread::hardware_concurrency();
+			return threads > 1 ? threads - 1 : 1;
+		}
+
+	private:
+		struct WorkerInfo
+		{
+			JobScheduler* scheduler;
+			size_t index;
+		};
+
+		ObjectPool<impl::Job> pool_;
+		std::vector<std::unique_ptr<impl::WorkStealingDeque>> deques_;	//One per worker.
+		MPMCIndexQueue injected_;										//Jobs run from threads that are not workers.
+		std::vector<std::thread> workers_;
+		size_t maxJobs_;
+		std::atomic_size_t liveJobs_;
+
+		std::atomic_bool running_;
+		std::atomic_size_t sleeping_;									//Number of workers waiting on wake_.
+		std::mutex sleepLock_;
+		std::condition_variable wake_;
+
+		static WorkerInfo*& workerSlot()
+		{
+			static thread_local WorkerInfo* info = nullptr;
+			return info;
+		}
+
+		//Returns the calling thread's worker info if it is a worker of this scheduler.
+		WorkerInfo* currentWorker()
+		{
+			auto info = workerSlot();
+			return info != nullptr && info->scheduler == this ? info : nullptr;
+		}
+
+		template <class F>
+		void splitRange(JobHandle parent, size_t begin, size_t end, size_t grain, F* fn)
+		{
+			auto body = [this, parent, begin, end, grain, fn]()
+			{
+				if (end - begin > grain)
+				{
+					//Split in half; the halves can be stolen by idle workers.
+					auto middle = begin + (end - begin) / 2;
+					splitRange(parent, begin, middle, grain, fn);
+					splitRange(parent, middle, end, grain, fn);
+					return;
+				}
+				for (auto i = begin; i < end; i++)
+				{
+					(*fn)(i);
+				}
+			};
+
+			JobHandle job;
+			if (tryCreate(body, parent, job))
+			{
+				run(job);
+			}
+			else
+			{
+				body();		//Out of job records; do the work here.
+			}
+		}
+
+		void execute(PoolIndex index)
+		{
+			auto& job = pool_.at(index);
+			job.invoke(job.data);
+			finish(index);
+		}
+
+		//Marks one unit of work of the job as done and releases it and notifies its parent once everything is done.
+		void finish(PoolIndex index)
+		{
+			auto& job = pool_.at(index);
+			if (job.unfinished.fetch_sub(1) != 1)
+			{
+				return;
+			}
+
+			auto parent = job.parent;
+			job.destroy(job.data);
+			job.generation++;
+			pool_.release(index);
+			liveJobs_--;
+
+			if (parent != GDBASE_INVALID_ID)
+			{
+				finish(parent);
+			}
+		}
+
+		//Executes one queued job if any can be found. Returns false if there was nothing to do.
+		bool executeOne()
+		{
+			PoolIndex index;
+			auto worker = currentWorker();
+			if ((worker != nullptr && deques_[worker->index]->pop(index)) || injected_.pop(index) || steal(worker, index))
+			{
+				execute(index);
+				return true;
+			}
+			return false;
+		}
+
+		bool steal(WorkerInfo* worker, PoolIndex& index)
+		{
+			//Start at a different victim each time so thieves spread out.
+			static thread_local size_t seed = std::hash<std::thread::id>()(std::this_thread::get_id());
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			auto start = (size_t)(seed >> 33);
+
+			for (size_t i = 0; i < deques_.size(); i++)
+			{
+				auto victim = (start + i) % deques_.size();
+				if ((worker == nullptr || victim != worker->index) && deques_[victim]->steal(index))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void workerLoop(size_t index)
+		{
+			WorkerInfo info{ this, index };
+			workerSlot() = &info;
+
+			size_t idleSpins = 0;
+			while (running_.load())
+			{
+				if (executeOne())
+				{
+					idleSpins = 0;
+					continue;
+				}
+
+				if (++idleSpins < 64)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				//Nothing to do for a while; sleep until a job is run. The timeout covers a wake up that raced with going to sleep.
+				std::unique_lock<std::mutex> guard(sleepLock_);
+				sleeping_++;
+				if (running_.load())
+				{
+					wake_.wait_for(guard, std::chrono::milliseconds(1));
+				}
+				sleeping_--;
+				idleSpins = 0;
+			}
+			workerSlot() = nullptr;
+		}
+	};
+};
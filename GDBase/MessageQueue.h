@@ -0,0 +1,256 @@
+#pragma once
+
+#include "pch.h"
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#include "ObjectPool.h"
+
+#define GDBASE_INDEXQUEUE_CAPACITY 1024		//Default capacity of an IndexQueue. Rounded up to a power of 2.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		struct IndexQueueCell;		//One slot of an IndexQueue.
+	}
+
+	template <bool singleConsumer>
+	class IndexQueue;			//Bounded lock free queue of pool indices.
+
+	using MPMCIndexQueue = IndexQueue<false>;	//Any number of producers and consumers.
+	using MPSCIndexQueue = IndexQueue<true>;	//Any number of producers, one consumer.
+
+	template <class Msg, bool singleConsumer = false>
+	class MessageQueue;			//IndexQueue whose payloads live in an ObjectPool.
+
+	//Class definitions
+	struct impl::IndexQueueCell
+	{
+		std::atomic_size_t sequence;	//Position this cell is ready for. Equal to the position when free, position + 1 when full.
+		PoolIndex value;
+	};
+
+	/*
+		IndexQueue
+		Bounded lock free ring queue of pool indices.
+		Each cell carries a sequence number so producers and consumers only contend on the position counters,
+		and a batch of any size is claimed with a single compare and swap.
+		With singleConsumer set, popping does not need atomic read-modify-writes; only one thread may pop.
+	*/
+	template <bool singleConsumer>
+	class IndexQueue
+	{
+	public:
+		explicit IndexQueue(size_t capacity = GDBASE_INDEXQUEUE_CAPACITY) : enqueuePos_(0), dequeuePos_(0)
+		{
+			//Round capacity up to a power of 2 so positions can be masked.
+			capacity_ = 2;
+			while (capacity_ < capacity)
+			{
+				capacity_ <<= 1;
+			}
+
+			cells_ = std::make_unique<impl::IndexQueueCell[]>(capacity_);
+			for (size_t i = 0; i < capacity_; i++)
+			{
+				cells_[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		//Pushes index. Returns false if the queue is full.
+		bool push(PoolIndex index) { return pushMultiple(&index, 1) == 1; }
+
+		//Pushes up to count indices in order. Returns the number pushed, which is less than count if the queue fills up.
+		size_t pushMultiple(const PoolIndex* indices, size_t count)
+		{
+			auto pos = enqueuePos_.load(std::memory_order_relaxed);
+			size_t claimed;
+
+			while (true)
+			{
+				//Count consecutive free cells starting at pos.
+				claimed = 0;
+				while (claimed < count && cellAt(pos + claimed).sequence.load(std::memory_order_acquire) == pos + claimed)
+				{
+					claimed++;
+				}
+
+				if (claimed == 0)
+				{
+					auto difference = (intptr_t)cellAt(pos).sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+					if (difference < 0 || count == 0)	//Full.
+					{
+						return 0;
+					}
+					pos = enqueuePos_.load(std::memory_order_relaxed);	//Another producer took pos.
+				}
+				else if (enqueuePos_.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+
+			for (size_t i = 0; i < claimed; i++)
+			{
+				auto& cell = cellAt(pos + i);
+				cell.value = indices[i];
+				cell.sequence.store(pos + i + 1, std::memory_order_release);
+			}
+			return claimed;
+		}
+
+		//Pops the oldest index into index. Returns false if the queue is empty.
+		bool pop(PoolIndex& index) { return popMultiple(&index, 1) == 1; }
+
+		//Pops up to maxCount indices in order. Returns the number popped.
+		size_t popMultiple(PoolIndex* indices, size_t maxCount)
+		{
+			auto pos = dequeuePos_.load(std::memory_order_relaxed);
+			size_t claimed;
+
+			while (true)
+			{
+				//Count consecutive full cells starting at pos.
+				claimed = 0;
+				while (claimed < maxCount && cellAt(pos + claimed).sequence.load(std::memory_order_acquire) == pos + claimed + 1)
+				{
+					claimed++;
+				}
+
+				if (singleConsumer)
+				{
+					dequeuePos_.store(pos + claimed, std::memory_order_relaxed);
+					break;
+				}
+
+				if (claimed == 0)
+				{
+					auto difference = (intptr_t)cellAt(pos).sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+					if (difference < 0 || maxCount == 0)	//Empty.
+					{
+						return 0;
+					}
+					pos = dequeuePos_.load(std::memory_order_relaxed);	//Another consumer took pos.
+				}
+				else if (dequeuePos_.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+
+			for (size_t i = 0; i < claimed; i++)
+			{
+				auto& cell = cellAt(pos + i);
+				indices[i] = cell.value;
+				cell.sequence.store(pos + i + capacity_, std::memory_order_release);	//Free for the next lap.
+			}
+			return claimed;
+		}
+
+		size_t capacity() const { return capacity_; }
+
+		//Number of indices in the queue. Only exact when no other thread is pushing or popping.
+		size_t size() const
+		{
+			auto size = (intptr_t)enqueuePos_.load(std::memory_order_relaxed) - (intptr_t)dequeuePos_.load(std::memory_order_relaxed);
+			return size > 0 ? (size_t)size : 0;
+		}
+
+		bool isEmpty() const { return size() == 0; }
+
+	private:
+		std::unique_ptr<impl::IndexQueueCell[]> cells_;
+		size_t capacity_;
+
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic_size_t enqueuePos_;	//Next position to push to.
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic_size_t dequeuePos_;	//Next position to pop from.
+
+		impl::IndexQueueCell& cellAt(size_t pos) { return cells_[pos & (capacity_ - 1)]; }
+	};
+
+	/*
+		MessageQueue
+		Passes messages between threads without allocating. Payloads are reserved from an ObjectPool
+		and only their indices travel through an IndexQueue; the consumer releases the payload when it is done with it.
+		The pool is allocated up front, by default for twice the queue's capacity: a full queue plus as many payloads again
+		that are reserved but not yet pushed, or popped but not yet released. It only grows if more payloads than that are
+		reserved at once, which is not safe while other threads use it, so pass a larger poolSize for such peaks.
+	*/
+	template <class Msg, bool singleConsumer>
+	class MessageQueue
+	{
+	public:
+		/*
+			MessageQueue Constructor
+			@capacity	Maximum number of messages in the queue, rounded up to a power of 2.
+			@poolSize	Initial size of the payload pool rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE.
+						0 sizes it for twice the queue's capacity.
+		*/
+		explicit MessageQueue(size_t capacity = GDBASE_INDEXQUEUE_CAPACITY, size_t poolSize = 0)
+			: queue_(capacity), pool_(poolSize > 0 ? poolSize : queue_.capacity() * 2) {}
+
+		//Reserves a payload. Fill it through at() and pass the index to push().
+		PoolIndex reserve() { return pool_.reserve(); }
+
+		Msg& at(PoolIndex index) { return pool_.at(index); }
+
+		//Returns a payload to the pool. Called by the consumer once it is done with a popped message.
+		void release(PoolIndex index) { pool_.release(index); }
+
+		void releaseMultiple(const PoolIndex* indices, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				pool_.release(indices[i]);
+			}
+		}
+
+		//Pushes a reserved payload. Returns false if the queue is full; the payload stays reserved.
+		bool push(PoolIndex index) { return queue_.push(index); }
+		size_t pushMultiple(const PoolIndex* indices, size_t count) { return queue_.pushMultiple(indices, count); }
+
+		//Pops the index of the oldest message. The payload stays reserved until released.
+		bool pop(PoolIndex& index) { return queue_.pop(index); }
+		size_t popMultiple(PoolIndex* indices, size_t maxCount) { return queue_.popMultiple(indices, maxCount); }
+
+		//Copies msg into a payload and pushes it. Returns false if the queue is full.
+		bool send(const Msg& msg)
+		{
+			auto index = reserve();
+			pool_.at(index) = msg;
+			if (!queue_.push(index))
+			{
+				pool_.release(index);
+				return false;
+			}
+			return true;
+		}
+
+		//Moves the oldest message into msg and releases its payload. Returns false if the queue is empty.
+		bool receive(Msg& msg)
+		{
+			PoolIndex index;
+			if (!queue_.pop(index))
+			{
+				return false;
+			}
+			msg = std::move(pool_.at(index));
+			pool_.release(index);
+			return true;
+		}
+
+		size_t size() const { return queue_.size(); }
+		bool isEmpty() const { return queue_.isEmpty(); }
+		size_t capacity() const { return queue_.capacity(); }
+
+		ObjectPool<Msg>& getPool() { return pool_; }
+
+	private:
+		IndexQueue<singleConsumer> queue_;
+		ObjectPool<Msg> pool_;
+	};
+};
@@ -7,19 +7,79 @@
 #include <future>
 #include <iterator>
 #include <optional>
+#include <cstdint>
 
 
 #define GDBASE_OBJECTPOOL_BLOCK_SIZE 1000
 #define GDBASE_OBJECTPOOL_MAX_BLOCKS 1000
+#define GDBASE_CACHE_LINE_SIZE 64
+
+#ifndef GDBASE_INDEX_TYPE
+#define GDBASE_INDEX_TYPE uint32_t		//Type of object indices. Define as size_t before including GDBase for pools of more than 4 billion objects.
+#endif
+
+#define GDBASE_INVALID_ID (GDBase::PoolIndex)-1
 
 #include "..//GDBaseTests/TestClasses.h"
 
 
 namespace GDBase
 {
+	using PoolIndex = GDBASE_INDEX_TYPE;	//Index of an object in a pool.
+
 	namespace impl
 	{
 		class AtomicBoolWrapper;	//Wrapper for atomic_bool thats default and copy constructable so that it may be used in STL structures.
+
+		class InUseFlags;			//Blocks of in use flags that stay in place when more blocks are added.
+	};
+
+	class impl::AtomicBoolWrapper
+	{
+	public:
+		std::atomic<bool> val;
+		AtomicBoolWrapper()
+		{
+			val.store(false);
+		}
+
+		AtomicBoolWrapper(const AtomicBoolWrapper& other)
+		{
+			val.store(other.val.load());
+		}
+	};
+
+	class impl::InUseFlags
+	{
+	public:
+		InUseFlags() : blocks_(new AtomicBoolWrapper* [GDBASE_OBJECTPOOL_MAX_BLOCKS]), nBlocks_(0) {}
+
+		~InUseFlags()
+		{
+			for (size_t block = 0; block < nBlocks_; block++)
+			{
+				delete[] blocks_[block];
+			}
+			delete[] blocks_;
+		}
+
+		InUseFlags(const InUseFlags&) = delete;
+		InUseFlags& operator=(const InUseFlags&) = delete;
+
+		AtomicBoolWrapper& operator[](size_t index) { return blocks_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+
+		//Allocates blocks until there are nBlocks. Existing flags do not move, so other threads may keep using them.
+		void addBlocks(size_t nBlocks)
+		{
+			for (; nBlocks_ < nBlocks; nBlocks_++)
+			{
+				blocks_[nBlocks_] = new AtomicBoolWrapper[GDBASE_OBJECTPOOL_BLOCK_SIZE];
+			}
+		}
+
+	private:
+		AtomicBoolWrapper** blocks_;
+		size_t nBlocks_;
 	};
 
 	/*
@@ -39,7 +99,7 @@ namespace GDBase
 			//Round capacity up to the next block size that can contain initialsize
 			capacity_ = (initialSize / GDBASE_OBJECTPOOL_BLOCK_SIZE * GDBASE_OBJECTPOOL_BLOCK_SIZE) + (initialSize % GDBASE_OBJECTPOOL_BLOCK_SIZE > 0 ? GDBASE_OBJECTPOOL_BLOCK_SIZE : 0);
 
-			isInUse_ = std::vector<impl::AtomicBoolWrapper>(capacity_);						//
+			isInUse_.addBlocks(capacity_ / GDBASE_OBJECTPOOL_BLOCK_SIZE);
 			poolObjects_ = new Obj* [GDBASE_OBJECTPOOL_MAX_BLOCKS];		//Create block array
 
 			//Create initial blocks
@@ -71,47 +131,39 @@ namespace GDBase
 			delete[] poolObjects_;
 		}
 
-		virtual bool isInUse(size_t index) { return (index < capacity_) && (isInUse_[index].val); }
-		virtual Obj& at(size_t index) { return poolObjects_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+		virtual bool isInUse(PoolIndex index) { return (index < capacity_) && (isInUse_[index].val); }
+		virtual Obj& at(PoolIndex index) { return poolObjects_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
 
 		//Reserves one object. Returns the index to the object.
-		virtual size_t reserve()
+		virtual PoolIndex reserve()
 		{
-			auto currentPosition = currentPosition_.load();
-			bool expected = false;
-
-			if (currentPosition >= capacity_)
+			for (;;)
 			{
-				increaseCapacity(capacity_ + GDBASE_OBJECTPOOL_BLOCK_SIZE);
-			}
-
-			//Attempt to reserve 
-			while (!isInUse_[currentPosition].val.compare_exchange_strong(expected, true))
-			{
-				if (currentPosition >= capacity_)	//Capacity check
+				auto currentPosition = currentPosition_.load();
+				if (currentPosition >= capacity_)	//Capacity check, done before every attempt since another thread may have moved currentPosition_ past the end.
 				{
-					increaseCapacity(capacity_ + GDBASE_OBJECTPOOL_BLOCK_SIZE);
+					increaseCapacity(blockEnd(currentPosition));
 				}
 
-				if (currentPosition == currentPosition_.load())	//Increment currentPosition_ if it has not changed.
+				//Attempt to reserve
+				bool expected = false;
+				if (isInUse_[currentPosition].val.compare_exchange_strong(expected, true))
 				{
-					currentPosition_++;
+					auto expectedPosition = currentPosition;	//Copy so a failed exchange does not overwrite the reserved index.
+					currentPosition_.compare_exchange_strong(expectedPosition, currentPosition + 1);	//Increment currentPosition_ by 1 if its value has not changed.
+					return (PoolIndex)currentPosition;
 				}
-				expected = false;	//Set expected back to false
-				currentPosition = currentPosition_.load();	//set currentPosition
+				currentPosition_.compare_exchange_strong(currentPosition, currentPosition + 1);	//Increment currentPosition_ if it has not changed.
 			}
-
-			currentPosition_.compare_exchange_strong(currentPosition, currentPosition + 1);	//Increment currentPosition_ by 1 if its value has not changed.
-			return currentPosition;
 		}
 
 		/*
 			Reserves multiple objects and returns a vector of reserved ids.
 			@amount Amount of objects to reserve.
 		*/
-		virtual void reserveMultiple(size_t*& ids, size_t amount)
+		virtual void reserveMultiple(PoolIndex*& ids, size_t amount)
 		{
-			ids = new size_t[amount];
+			ids = new PoolIndex[amount];
 			auto currentPosition = currentPosition_.load();
 			bool expected = false;
 			size_t toReserve = amount, expectedEnd, index = 0;
@@ -123,7 +175,7 @@ namespace GDBase
 				{
 					if ((currentPosition + toReserve) >= capacity_)	//Capacity check
 					{
-						increaseCapacity((capacity_ + toReserve) % GDBASE_OBJECTPOOL_BLOCK_SIZE > 0 ? ((capacity_ + toReserve) / GDBASE_OBJECTPOOL_BLOCK_SIZE + GDBASE_OBJECTPOOL_BLOCK_SIZE) : (capacity_ + toReserve));
+						increaseCapacity(blockEnd(currentPosition + toReserve));
 					}
 				} while (!currentPosition_.compare_exchange_strong(currentPosition, currentPosition + toReserve));	//Push marker forward
 
@@ -135,7 +187,7 @@ namespace GDBase
 					if (isInUse_[i].val.compare_exchange_strong(expected, true))	//If successfully marked, add id to ids.
 					{
 						toReserve--;
-						ids[index++] = i;
+						ids[index++] = (PoolIndex)i;
 					}
 				}
 
@@ -151,9 +203,9 @@ namespace GDBase
 			Reserves multiple objects and returns a vector of reserved ids.
 			@amount Amount of objects to reserve.
 		*/
-		virtual std::vector<size_t> reserveMultiple(size_t amount)
+		virtual std::vector<PoolIndex> reserveMultiple(size_t amount)
 		{
-			std::vector<size_t> ids;
+			std::vector<PoolIndex> ids;
 			auto currentPosition = currentPosition_.load();
 			bool expected = false;
 			size_t toReserve = amount, expectedEnd;
@@ -165,7 +217,7 @@ namespace GDBase
 				{
 					if ((currentPosition + toReserve) >= capacity_)	//Capacity check
 					{
-						increaseCapacity((capacity_ + toReserve) % GDBASE_OBJECTPOOL_BLOCK_SIZE > 0 ? ((capacity_ + toReserve) / GDBASE_OBJECTPOOL_BLOCK_SIZE + GDBASE_OBJECTPOOL_BLOCK_SIZE) : (capacity_ + toReserve));
+						increaseCapacity(blockEnd(currentPosition + toReserve));
 					}
 				} while (!currentPosition_.compare_exchange_strong(currentPosition, currentPosition + toReserve));	//Push marker forward
 
@@ -177,7 +229,7 @@ namespace GDBase
 					if (isInUse_[i].val.compare_exchange_strong(expected, true))	//If successfully marked, add id to ids.
 					{
 						toReserve--;
-						ids.push_back(i);
+						ids.push_back((PoolIndex)i);
 					}
 				}
 
@@ -191,7 +243,7 @@ namespace GDBase
 		}
 
 		//Releases an object from use.
-		virtual void release(size_t index)
+		virtual void release(PoolIndex index)
 		{
 			auto curPosition = currentPosition_.load();
 			isInUse_[index].val.store(false);
@@ -200,9 +252,9 @@ namespace GDBase
 
 	protected:
 		Obj** poolObjects_;
-		std::vector<impl::AtomicBoolWrapper> isInUse_;
+		impl::InUseFlags isInUse_;
 		std::mutex capacityLock_;
-		size_t capacity_;									//Max capacity of the object pool
+		std::atomic_size_t capacity_;						//Max capacity of the object pool. Stored after the blocks it covers are allocated.
 		std::atomic_size_t currentPosition_;					//Position of the first free object
 
 		//Increases capacity of object pool to newCapacity. Does nothing if newCapacity is less than the current capacity.
@@ -214,8 +266,8 @@ namespace GDBase
 			if (capacity_ < newCapacity)
 			{
 				//objects_.reserve(newCapacity);
-				isInUse_.resize(newCapacity);
 				auto nNewBlocks = newCapacity / GDBASE_OBJECTPOOL_BLOCK_SIZE;
+				isInUse_.addBlocks(nNewBlocks);
 
 				//Create and populate new blocks
 				for (size_t block = capacity_ / GDBASE_OBJECTPOOL_BLOCK_SIZE; block < nNewBlocks; block++)
@@ -225,20 +277,8 @@ namespace GDBase
 				capacity_ = newCapacity;	//Update capacity
 			}
 		}	//capacityLock_ released on lock destruction.
-	};
-
-	class impl::AtomicBoolWrapper
-	{
-	public:
-		std::atomic<bool> val;
-		AtomicBoolWrapper()
-		{
-			val.store(false);
-		}
 
-		AtomicBoolWrapper(const AtomicBoolWrapper& other)
-		{
-			val.store(other.val.load());
-		}
+		//Capacity of whole blocks needed to hold the object at position.
+		static size_t blockEnd(size_t position) { return (position / GDBASE_OBJECTPOOL_BLOCK_SIZE + 1) * GDBASE_OBJECTPOOL_BLOCK_SIZE; }
 	};
 };
\ No newline at end of file
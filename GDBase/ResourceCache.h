@@ -0,0 +1,382 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+
+#include "AutoObjectPool.h"
+
+#define GDBASE_RESOURCECACHE_SHARDS 16			//Number of independently locked key maps.
+#define GDBASE_RESOURCECACHE_MAX_IDLE 1000		//Default number of unreferenced objects kept resident.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		template <class Key>
+		struct CacheEntry;			//Per object bookkeeping of a ResourceCache.
+
+		template <class Key, class Hash>
+		struct CacheShard;			//One independently locked part of the key map.
+
+		class SpinLock;				//Minimal lock for short critical sections on a single entry.
+	}
+
+	template <class Key, class Obj, class Hash = std::hash<Key>>
+	class ResourceCache;		//Keyed cache of AutoObjectPool objects.
+
+	//Class definitions
+	class impl::SpinLock
+	{
+	public:
+		void lock()
+		{
+			while (flag_.test_and_set(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		void unlock() { flag_.clear(std::memory_order_release); }
+
+	private:
+		std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+	};
+
+	/*
+		CacheEntry
+		key and state only change while lock is held. An entry only becomes LIVE after the PoolObject handed out for it
+		has been created, so an entry seen as LIVE with no references is really unreferenced.
+	*/
+	template <class Key>
+	struct impl::CacheEntry
+	{
+		static constexpr uint8_t FREE = 0;		//Not in the cache.
+		static constexpr uint8_t LIVE = 1;		//In the cache and referenced by at least one PoolObject.
+		static constexpr uint8_t IDLE = 2;		//In the cache and unreferenced. May be evicted.
+		static constexpr uint8_t LOADING = 3;	//In the key map while its object is loaded outside the shard lock.
+
+		Key key;
+		std::atomic<uint8_t> state{ FREE };
+		std::atomic_bool referenced{ false };	//CLOCK reference bit. Set on every hit, cleared as the clock hand passes.
+		SpinLock lock;							//Taken after the shard lock.
+	};
+
+	template <class Key, class Hash>
+	struct alignas(GDBASE_CACHE_LINE_SIZE) impl::CacheShard
+	{
+		std::mutex lock;
+		std::unordered_map<Key, PoolIndex, Hash> indices;	//Key to pool index.
+	};
+
+	/*
+		ResourceCache
+		An AutoObjectPool whose objects are looked up by key.
+		Objects that are no longer referenced by any PoolObject stay resident and can be found again until they are evicted,
+		either because more than maxIdle objects are unreferenced (least recently used first, approximated with CLOCK) or by evict().
+		Keys are spread over GDBASE_RESOURCECACHE_SHARDS separately locked maps so lookups of different keys rarely contend.
+	*/
+	template <class Key, class Obj, class Hash>
+	class ResourceCache : protected AutoObjectPool<Obj>
+	{
+	public:
+		/*
+			ResourceCache Constructor
+			@maxIdle		Number of unreferenced objects kept before the least recently used are evicted.
+			@initialSize	Initial size of the object pool rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
+		*/
+		explicit ResourceCache(size_t maxIdle = GDBASE_RESOURCECACHE_MAX_IDLE, size_t initialSize = 1000)
+			: AutoObjectPool<Obj>(Obj(), initialSize), entryBlocks_(0), maxIdle_(maxIdle), idleCount_(0), clockHand_(0)
+		{
+			entries_ = new impl::CacheEntry<Key>* [GDBASE_OBJECTPOOL_MAX_BLOCKS];
+			addEntryBlocks(capacity_);
+		}
+
+		//Evicts every resident object first, while it can still call back into the cache through PoolObjects it holds.
+		~ResourceCache()
+		{
+			maxIdle_.store(0);		//Objects released by evicted objects are evicted as well.
+			while (idleCount_.load() > 0)
+			{
+				clear();
+			}
+
+			for (size_t block = 0; block < entryBlocks_.load(); block++)
+			{
+				delete[] entries_[block];
+			}
+			delete[] entries_;
+		}
+
+		/*
+			Returns the object stored under key, calling load(key) to create it if it is not in the cache.
+			load is called without any lock held, so it may get other resources from the cache. The key is marked as loading
+			first, so each key is only loaded once; other threads getting it wait until it is loaded.
+			load must not get its own key, directly or through the resources it loads.
+			If load throws, the key is removed again and the exception is passed on; threads waiting for it load it themselves.
+		*/
+		template <class Loader>
+		PoolObject<Obj> get(const Key& key, Loader&& load)
+		{
+			auto& shard = shardOf(key);
+			PoolIndex index;
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> shardGuard(shard.lock);
+					auto found = shard.indices.find(key);
+					if (found == shard.indices.end())
+					{
+						index = this->reserve();
+						auto& entry = entryAt(index);
+						{
+							std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+							entry.key = key;
+							entry.referenced.store(false);
+							entry.state.store(impl::CacheEntry<Key>::LOADING);
+						}
+						shard.indices.emplace(key, index);
+						break;
+					}
+					if (entryAt(found->second).state.load() != impl::CacheEntry<Key>::LOADING)
+					{
+						return acquire(found->second);
+					}
+					index = found->second;
+				}
+
+				//Another thread is loading the key. Look it up again once it is done, as it may have been evicted since.
+				while (entryAt(index).state.load() == impl::CacheEntry<Key>::LOADING)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			try
+			{
+				*internalAt(index) = load(key);
+			}
+			catch (...)
+			{
+				{
+					std::lock_guard<std::mutex> shardGuard(shard.lock);
+					shard.indices.erase(key);
+				}
+				{
+					auto& entry = entryAt(index);
+					std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+					entry.state.store(impl::CacheEntry<Key>::FREE);
+				}
+				AutoObjectPool<Obj>::resetObject(index);
+				throw;
+			}
+
+			PoolObject<Obj> object(internalAt(index));
+			auto& entry = entryAt(index);
+			{
+				std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+				entry.state.store(impl::CacheEntry<Key>::LIVE);
+			}
+			return object;
+		}
+
+		//Returns the object stored under key if it is in the cache. Objects still being loaded are not found.
+		std::optional<PoolObject<Obj>> find(const Key& key)
+		{
+			auto& shard = shardOf(key);
+			std::lock_guard<std::mutex> shardGuard(shard.lock);
+
+			auto found = shard.indices.find(key);
+			if (found == shard.indices.end() || entryAt(found->second).state.load() == impl::CacheEntry<Key>::LOADING)
+			{
+				return std::nullopt;
+			}
+			return acquire(found->second);
+		}
+
+		bool contains(const Key& key)
+		{
+			auto& shard = shardOf(key);
+			std::lock_guard<std::mutex> shardGuard(shard.lock);
+			auto found = shard.indices.find(key);
+			return found != shard.indices.end() && entryAt(found->second).state.load() != impl::CacheEntry<Key>::LOADING;
+		}
+
+		/*
+			Evicts up to count unreferenced objects, least recently used first. Returns the number evicted.
+			Call when under memory pressure.
+			Evicted objects are reset once clockLock_ is released, as they may hold PoolObjects of this cache and releasing
+			those can evict again.
+		*/
+		size_t evict(size_t count)
+		{
+			std::vector<PoolIndex> evicted;
+			{
+				std::lock_guard<std::mutex> clockGuard(clockLock_);
+				sweep(count, evicted);
+			}
+
+			for (auto index : evicted)
+			{
+				*internalAt(index) = this->getDefaultObject();		//Free whatever the object holds.
+				AutoObjectPool<Obj>::resetObject(index);
+			}
+			return evicted.size();
+		}
+
+		//Evicts every unreferenced object.
+		size_t clear() { return evict((size_t)-1); }
+
+		size_t idleCount() { return idleCount_.load(); }
+		size_t getMaxIdle() { return maxIdle_.load(); }
+		void setMaxIdle(size_t maxIdle)
+		{
+			maxIdle_.store(maxIdle);
+			trim();
+		}
+
+		/*
+			Called when the object at index is no longer referenced.
+			Keeps the object in the cache as idle instead of releasing it.
+		*/
+		virtual void resetObject(PoolIndex index)
+		{
+			auto& entry = entryAt(index);
+			{
+				std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+
+				//A lookup may have referenced the object again, or the entry may have been evicted and reused, before the lock was taken.
+				if (internalAt(index).Count() > 0 || entry.state.load() != impl::CacheEntry<Key>::LIVE)
+				{
+					return;
+				}
+				entry.state.store(impl::CacheEntry<Key>::IDLE);
+				idleCount_++;
+			}
+			trim();
+		}
+
+	protected:
+		using AutoObjectPool<Obj>::poolObjects_;
+		using AutoObjectPool<Obj>::capacity_;
+		using AutoObjectPool<Obj>::capacityLock_;
+
+		impl::CacheShard<Key, Hash> shards_[GDBASE_RESOURCECACHE_SHARDS];
+		impl::CacheEntry<Key>** entries_;				//Blocks of entries parallel to poolObjects_.
+		std::atomic_size_t entryBlocks_;				//Number of entry blocks allocated.
+		std::atomic_size_t maxIdle_;
+		std::atomic_size_t idleCount_;					//Number of entries in the IDLE state.
+		std::mutex clockLock_;							//Taken before any shard lock.
+		size_t clockHand_;
+
+		impl::CacheShard<Key, Hash>& shardOf(const Key& key) { return shards_[Hash()(key) % GDBASE_RESOURCECACHE_SHARDS]; }
+		impl::CacheEntry<Key>& entryAt(PoolIndex index) { return entries_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+		impl::InternalPoolObj<Obj>& internalAt(PoolIndex index) { return poolObjects_[index / GDBASE_OBJECTPOOL_BLOCK_SIZE][index % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+
+		//Returns a PoolObject for a cached index. The index's shard must be locked.
+		PoolObject<Obj> acquire(PoolIndex index)
+		{
+			auto& entry = entryAt(index);
+			PoolObject<Obj> object(internalAt(index));
+			entry.referenced.store(true);
+
+			std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+			if (entry.state.load() == impl::CacheEntry<Key>::IDLE)
+			{
+				entry.state.store(impl::CacheEntry<Key>::LIVE);
+				idleCount_--;
+			}
+			return object;
+		}
+
+		//Moves the clock hand until up to count idle objects are removed from the cache, adding their indices to evicted. clockLock_ must be held.
+		void sweep(size_t count, std::vector<PoolIndex>& evicted)
+		{
+			auto end = entryBlocks_.load() * GDBASE_OBJECTPOOL_BLOCK_SIZE;
+
+			//Two sweeps: the first may only clear reference bits.
+			for (size_t step = 0; step < end * 2 && evicted.size() < count && idleCount_.load() > 0; step++)
+			{
+				auto index = (PoolIndex)clockHand_;
+				clockHand_ = (clockHand_ + 1) % end;
+
+				auto& entry = entryAt(index);
+				if (entry.state.load() != impl::CacheEntry<Key>::IDLE || entry.referenced.exchange(false))
+				{
+					continue;
+				}
+				if (tryEvict(index))
+				{
+					evicted.push_back(index);
+				}
+			}
+		}
+
+		//Removes an idle object from the cache. Its slot stays reserved until the caller resets the object and returns it to the pool.
+		bool tryEvict(PoolIndex index)
+		{
+			auto& entry = entryAt(index);
+			impl::CacheShard<Key, Hash>* shard;
+			{
+				std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+				if (entry.state.load() != impl::CacheEntry<Key>::IDLE)
+				{
+					return false;
+				}
+				shard = &shardOf(entry.key);
+			}
+
+			//Only eviction frees idle entries and clockLock_ is held, so the key can not change while the entry is unlocked.
+			std::lock_guard<std::mutex> shardGuard(shard->lock);
+			{
+				std::lock_guard<impl::SpinLock> entryGuard(entry.lock);
+				if (entry.state.load() != impl::CacheEntry<Key>::IDLE)	//Referenced again in the meantime.
+				{
+					return false;
+				}
+				shard->indices.erase(entry.key);
+				entry.state.store(impl::CacheEntry<Key>::FREE);
+				idleCount_--;
+			}
+			return true;
+		}
+
+		//Evicts until no more than maxIdle objects are idle.
+		void trim()
+		{
+			auto idle = idleCount_.load();
+			auto maxIdle = maxIdle_.load();
+			if (idle > maxIdle)
+			{
+				evict(idle - maxIdle);
+			}
+		}
+
+		void addEntryBlocks(size_t capacity)
+		{
+			for (auto block = entryBlocks_.load(); block < capacity / GDBASE_OBJECTPOOL_BLOCK_SIZE; block++)
+			{
+				entries_[block] = new impl::CacheEntry<Key>[GDBASE_OBJECTPOOL_BLOCK_SIZE];
+				entryBlocks_.store(block + 1);
+			}
+		}
+
+		//Adds entries for the new objects, then increases capacity of object pool to newCapacity.
+		virtual void increaseCapacity(size_t newCapacity)
+		{
+			{
+				//Before the new capacity is published, since get() uses the entry of any index it reserves.
+				std::lock_guard<std::mutex> capacityGuard(capacityLock_);
+				addEntryBlocks(newCapacity);
+			}
+			AutoObjectPool<Obj>::increaseCapacity(newCapacity);
+		}
+	};
+};
@@ -0,0 +1,335 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "ObjectPool.h"
+
+#define GDBASE_ROLLBACK_MAX_FRAMES 16	//Default number of snapshots kept by a RollbackObjectPool.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		template <class Obj>
+		struct PoolBlockDelta;		//Contents of one block as they were before a snapshot.
+
+		template <class Obj>
+		struct PoolDeltaFrame;		//One snapshot. Holds the previous state of every block changed since the snapshot before it.
+	}
+
+	template <class Obj>
+	class RollbackObjectPool;		//Object pool that can be rolled back to earlier snapshots.
+
+	//Class definitions
+	template <class Obj>
+	struct impl::PoolBlockDelta
+	{
+		size_t block;
+		std::unique_ptr<Obj[]> objects;		//nullptr if only occupancy changed.
+		std::unique_ptr<bool[]> inUse;		//nullptr if only objects changed.
+	};
+
+	template <class Obj>
+	struct impl::PoolDeltaFrame
+	{
+		std::vector<PoolBlockDelta<Obj>> deltas;
+		size_t currentPosition;				//Position of the first free object when the snapshot was taken.
+	};
+
+	/*
+		RollbackObjectPool
+		An object pool that records which blocks were written since the last snapshot.
+		snapshot() stores only the changed blocks into a ring of frames and restore() returns the pool to any frame still in the ring,
+		so the cost of both scales with how much changed rather than with the capacity of the pool.
+
+		Objects are marked as written when they are accessed through at(); use read() for access that does not write.
+		A reference returned by at() is only tracked until the next snapshot.
+		snapshot() and restore() must not be called while other threads are using the pool.
+	*/
+	template <class Obj>
+	class RollbackObjectPool : public ObjectPool<Obj>
+	{
+	public:
+		/*
+			RollbackObjectPool Constructor
+			@initialSize	Initial size of the object pool rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
+			@maxFrames		Number of snapshots kept. Taking more overwrites the oldest.
+		*/
+		explicit RollbackObjectPool<Obj>(size_t initialSize = 1000, size_t maxFrames = GDBASE_ROLLBACK_MAX_FRAMES)
+			: ObjectPool<Obj>(initialSize), frames_(maxFrames > 0 ? maxFrames : 1), nextFrame_(0), frameCount_(0)
+		{
+			init();
+		}
+
+		explicit RollbackObjectPool<Obj>(Obj& defaultObject, size_t initialSize = 1000, size_t maxFrames = GDBASE_ROLLBACK_MAX_FRAMES)
+			: ObjectPool<Obj>(defaultObject, initialSize), frames_(maxFrames > 0 ? maxFrames : 1), nextFrame_(0), frameCount_(0)
+		{
+			init();
+		}
+
+		//Returns the object at index and marks its block as written.
+		virtual Obj& at(PoolIndex index)
+		{
+			markDirty(index / GDBASE_OBJECTPOOL_BLOCK_SIZE, DIRTY_OBJECTS);
+			return ObjectPool<Obj>::at(index);
+		}
+
+		//Returns the object at index without marking its block as written.
+		const Obj& read(PoolIndex index) { return ObjectPool<Obj>::at(index); }
+
+		virtual PoolIndex reserve()
+		{
+			auto index = ObjectPool<Obj>::reserve();
+			markDirty(index / GDBASE_OBJECTPOOL_BLOCK_SIZE, DIRTY_IN_USE);
+			return index;
+		}
+
+		virtual void reserveMultiple(PoolIndex*& ids, size_t amount)
+		{
+			ObjectPool<Obj>::reserveMultiple(ids, amount);
+			for (size_t i = 0; i < amount; i++)
+			{
+				markDirty(ids[i] / GDBASE_OBJECTPOOL_BLOCK_SIZE, DIRTY_IN_USE);
+			}
+		}
+
+		virtual std::vector<PoolIndex> reserveMultiple(size_t amount)
+		{
+			auto ids = ObjectPool<Obj>::reserveMultiple(amount);
+			for (auto id : ids)
+			{
+				markDirty(id / GDBASE_OBJECTPOOL_BLOCK_SIZE, DIRTY_IN_USE);
+			}
+			return ids;
+		}
+
+		virtual void release(PoolIndex index)
+		{
+			markDirty(index / GDBASE_OBJECTPOOL_BLOCK_SIZE, DIRTY_IN_USE);
+			ObjectPool<Obj>::release(index);
+		}
+
+		/*
+			Stores the blocks changed since the last snapshot and returns the number of the new frame.
+			Frame numbers start at 0 and increase by one per snapshot.
+		*/
+		size_t snapshot()
+		{
+			std::lock_guard<std::mutex> capacityGuard(capacityLock_);
+			growShadow();
+
+			//Recycle the oldest frame if the ring is full.
+			auto& frame = frames_[nextFrame_ % frames_.size()];
+			recycle(frame);
+
+			for (size_t block = 0; block < shadowObjects_.size(); block++)
+			{
+				auto flags = dirty_[block].exchange(0, std::memory_order_relaxed);
+				if (flags == 0)
+				{
+					continue;
+				}
+
+				impl::PoolBlockDelta<Obj> delta;
+				delta.block = block;
+				if (flags & DIRTY_OBJECTS)
+				{
+					//Keep the previous contents for restore and bring the shadow copy up to date.
+					delta.objects = takeObjectBuffer();
+					copyObjects(delta.objects.get(), shadowObjects_[block].get());
+					copyObjects(shadowObjects_[block].get(), poolObjects_[block]);
+				}
+				if (flags & DIRTY_IN_USE)
+				{
+					delta.inUse = takeInUseBuffer();
+					std::copy(shadowInUse_[block].get(), shadowInUse_[block].get() + GDBASE_OBJECTPOOL_BLOCK_SIZE, delta.inUse.get());
+					for (size_t i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+					{
+						shadowInUse_[block][i] = isInUse_[block * GDBASE_OBJECTPOOL_BLOCK_SIZE + i].val.load();
+					}
+				}
+				frame.deltas.push_back(std::move(delta));
+			}
+
+			frame.currentPosition = currentPosition_.load();
+			frameCount_ = frameCount_ < frames_.size() ? frameCount_ + 1 : frameCount_;
+			return nextFrame_++;
+		}
+
+		/*
+			Returns the pool to the state it was in when frame was taken.
+			Frames taken after frame are discarded. Returns false if frame is no longer (or not yet) in the ring.
+		*/
+		bool restore(size_t frame)
+		{
+			if (!hasFrame(frame))
+			{
+				return false;
+			}
+
+			std::lock_guard<std::mutex> capacityGuard(capacityLock_);
+			growShadow();
+
+			//Undo everything written since the last snapshot. The shadow copy holds the state of the latest frame.
+			for (size_t block = 0; block < shadowObjects_.size(); block++)
+			{
+				auto flags = dirty_[block].exchange(0, std::memory_order_relaxed);
+				if (flags & DIRTY_OBJECTS)
+				{
+					copyObjects(poolObjects_[block], shadowObjects_[block].get());
+				}
+				if (flags & DIRTY_IN_USE)
+				{
+					applyInUse(block, shadowInUse_[block].get());
+				}
+			}
+
+			//Walk back from the latest frame, applying each frame's previous block contents.
+			for (auto current = nextFrame_ - 1; current > frame; current--)
+			{
+				auto& undo = frames_[current % frames_.size()];
+				for (auto& delta : undo.deltas)
+				{
+					if (delta.objects)
+					{
+						copyObjects(poolObjects_[delta.block], delta.objects.get());
+						copyObjects(shadowObjects_[delta.block].get(), delta.objects.get());
+					}
+					if (delta.inUse)
+					{
+						applyInUse(delta.block, delta.inUse.get());
+						std::copy(delta.inUse.get(), delta.inUse.get() + GDBASE_OBJECTPOOL_BLOCK_SIZE, shadowInUse_[delta.block].get());
+					}
+				}
+				recycle(undo);
+				frameCount_--;
+			}
+
+			currentPosition_.store(frames_[frame % frames_.size()].currentPosition);
+			nextFrame_ = frame + 1;
+			return true;
+		}
+
+		//Whether frame can be restored.
+		bool hasFrame(size_t frame) const { return frame < nextFrame_ && frame + frameCount_ >= nextFrame_; }
+
+		//Number of the most recent frame. Only meaningful if frameCount() > 0.
+		size_t latestFrame() const { return nextFrame_ - 1; }
+
+		//Number of frames that can be restored.
+		size_t frameCount() const { return frameCount_; }
+
+	protected:
+		using ObjectPool<Obj>::poolObjects_;
+		using ObjectPool<Obj>::isInUse_;
+		using ObjectPool<Obj>::capacityLock_;
+		using ObjectPool<Obj>::capacity_;
+		using ObjectPool<Obj>::currentPosition_;
+
+		static constexpr uint8_t DIRTY_OBJECTS = 1;
+		static constexpr uint8_t DIRTY_IN_USE = 2;
+
+		std::unique_ptr<std::atomic_uint8_t[]> dirty_;					//Per block flags of what changed since the last snapshot.
+		std::vector<std::unique_ptr<Obj[]>> shadowObjects_;				//Objects as of the latest frame.
+		std::vector<std::unique_ptr<bool[]>> shadowInUse_;				//Occupancy as of the latest frame.
+		std::vector<impl::PoolDeltaFrame<Obj>> frames_;					//Ring of snapshots.
+		size_t nextFrame_;												//Number given to the next snapshot.
+		size_t frameCount_;												//Number of valid frames in frames_.
+
+		std::vector<std::unique_ptr<Obj[]>> spareObjects_;				//Buffers from discarded frames, reused by later snapshots.
+		std::vector<std::unique_ptr<bool[]>> spareInUse_;
+
+		void init()
+		{
+			dirty_ = std::make_unique<std::atomic_uint8_t[]>(GDBASE_OBJECTPOOL_MAX_BLOCKS);
+			for (size_t block = 0; block < GDBASE_OBJECTPOOL_MAX_BLOCKS; block++)
+			{
+				dirty_[block].store(0, std::memory_order_relaxed);
+			}
+
+			//The shadow copy starts as the state of the pool after construction.
+			growShadow();
+			for (size_t block = 0; block < shadowObjects_.size(); block++)
+			{
+				copyObjects(shadowObjects_[block].get(), poolObjects_[block]);
+			}
+		}
+
+		void markDirty(size_t block, uint8_t flag)
+		{
+			//Plain load first so blocks already marked this tick do not need a read-modify-write.
+			if ((dirty_[block].load(std::memory_order_relaxed) & flag) == 0)
+			{
+				dirty_[block].fetch_or(flag, std::memory_order_relaxed);
+			}
+		}
+
+		//Adds shadow blocks for blocks created since the last snapshot. New blocks start default constructed and unused.
+		void growShadow()
+		{
+			for (auto block = shadowObjects_.size(); block < capacity_ / GDBASE_OBJECTPOOL_BLOCK_SIZE; block++)
+			{
+				shadowObjects_.push_back(std::make_unique<Obj[]>(GDBASE_OBJECTPOOL_BLOCK_SIZE));
+				shadowInUse_.push_back(std::make_unique<bool[]>(GDBASE_OBJECTPOOL_BLOCK_SIZE));
+			}
+		}
+
+		std::unique_ptr<Obj[]> takeObjectBuffer()
+		{
+			if (spareObjects_.empty())
+			{
+				return std::make_unique<Obj[]>(GDBASE_OBJECTPOOL_BLOCK_SIZE);
+			}
+			auto buffer = std::move(spareObjects_.back());
+			spareObjects_.pop_back();
+			return buffer;
+		}
+
+		std::unique_ptr<bool[]> takeInUseBuffer()
+		{
+			if (spareInUse_.empty())
+			{
+				return std::make_unique<bool[]>(GDBASE_OBJECTPOOL_BLOCK_SIZE);
+			}
+			auto buffer = std::move(spareInUse_.back());
+			spareInUse_.pop_back();
+			return buffer;
+		}
+
+		//Empties frame and keeps its buffers for reuse.
+		void recycle(impl::PoolDeltaFrame<Obj>& frame)
+		{
+			for (auto& delta : frame.deltas)
+			{
+				if (delta.objects)
+				{
+					spareObjects_.push_back(std::move(delta.objects));
+				}
+				if (delta.inUse)
+				{
+					spareInUse_.push_back(std::move(delta.inUse));
+				}
+			}
+			frame.deltas.clear();
+		}
+
+		static void copyObjects(Obj* dest, const Obj* src)
+		{
+			std::copy(src, src + GDBASE_OBJECTPOOL_BLOCK_SIZE, dest);
+		}
+
+		void applyInUse(size_t block, const bool* inUse)
+		{
+			for (size_t i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+			{
+				isInUse_[block * GDBASE_OBJECTPOOL_BLOCK_SIZE + i].val.store(inUse[i]);
+			}
+		}
+	};
+};
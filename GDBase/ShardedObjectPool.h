@@ -0,0 +1,275 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cstdint>
+
+#include "ObjectPool.h"
+#include "FixedObjectPool.h"
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		template <class Obj>
+		struct ShardBlock;				//Objects and occupancy bits of one block of a PoolShard.
+
+		template <class Obj>
+		class PoolShard;				//One shard of a ShardedObjectPool, with its own blocks, occupancy and cursor.
+	}
+
+	template <class Obj>
+	class ShardedObjectPool;			//Object pool split into shards so threads reserve without sharing a cursor.
+
+	//Class definitions
+	template <class Obj>
+	struct impl::ShardBlock
+	{
+		static constexpr size_t WORDS = (GDBASE_OBJECTPOOL_BLOCK_SIZE + 63) / 64;
+
+		Obj objects[GDBASE_OBJECTPOOL_BLOCK_SIZE];
+		std::atomic<uint64_t> inUse[WORDS];
+	};
+
+	/*
+		PoolShard
+		Growable bitmap pool. available_ counts the free objects; a thread takes one from it before searching the bitmap,
+		so the search always finds a free bit and a shard with nothing available is skipped without touching its bitmap.
+		Blocks are allocated and filled by the thread that grows the shard, so with first touch placement they live in
+		the memory of the node that thread runs on.
+	*/
+	template <class Obj>
+	class alignas(GDBASE_CACHE_LINE_SIZE) impl::PoolShard
+	{
+	public:
+		static constexpr size_t NONE = (size_t)-1;
+
+		explicit PoolShard(const Obj& defaultObject) : defaultObject_(defaultObject), nBlocks_(0), available_(0), cursor_(0) {}
+
+		~PoolShard()
+		{
+			for (size_t block = 0; block < nBlocks_.load(); block++)
+			{
+				delete blocks_[block];
+			}
+		}
+
+		Obj& at(size_t local) { return blocks_[local / GDBASE_OBJECTPOOL_BLOCK_SIZE]->objects[local % GDBASE_OBJECTPOOL_BLOCK_SIZE]; }
+
+		bool isInUse(size_t local)
+		{
+			auto block = local / GDBASE_OBJECTPOOL_BLOCK_SIZE;
+			auto offset = local % GDBASE_OBJECTPOOL_BLOCK_SIZE;
+			return block < nBlocks_.load() && (blocks_[block]->inUse[offset / 64].load() & ((uint64_t)1 << (offset % 64))) != 0;
+		}
+
+		bool hasAvailable() const { return available_.load(std::memory_order_relaxed) > 0; }
+		size_t getCapacity() const { return nBlocks_.load() * GDBASE_OBJECTPOOL_BLOCK_SIZE; }
+		size_t getAvailable() const { return available_.load(); }
+
+		//Reserves a free object of this shard without growing it. Returns its local index, or NONE if the shard is full.
+		size_t tryReserve()
+		{
+			auto available = available_.load(std::memory_order_relaxed);
+			do
+			{
+				if (available == 0)
+				{
+					return NONE;
+				}
+			} while (!available_.compare_exchange_weak(available, available - 1, std::memory_order_acquire, std::memory_order_relaxed));
+
+			//A free bit is guaranteed to exist, though other threads may take the ones seen first.
+			for (auto word = cursor_.load(std::memory_order_relaxed);; word++)
+			{
+				auto nWords = nBlocks_.load(std::memory_order_acquire) * ShardBlock<Obj>::WORDS;
+				word %= nWords;
+				auto& bits = blocks_[word / ShardBlock<Obj>::WORDS]->inUse[word % ShardBlock<Obj>::WORDS];
+				auto value = bits.load(std::memory_order_relaxed);
+				while (~value != 0)
+				{
+					auto free = countTrailingZeros(~value);
+					if (bits.compare_exchange_weak(value, value | ((uint64_t)1 << free), std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						cursor_.store(word, std::memory_order_relaxed);
+						return word / ShardBlock<Obj>::WORDS * GDBASE_OBJECTPOOL_BLOCK_SIZE + word % ShardBlock<Obj>::WORDS * 64 + free;
+					}
+				}
+			}
+		}
+
+		void release(size_t local)
+		{
+			auto block = local / GDBASE_OBJECTPOOL_BLOCK_SIZE;
+			auto offset = local % GDBASE_OBJECTPOOL_BLOCK_SIZE;
+			blocks_[block]->inUse[offset / 64].fetch_and(~((uint64_t)1 << (offset % 64)), std::memory_order_release);
+			available_.fetch_add(1, std::memory_order_release);
+
+			auto word = block * ShardBlock<Obj>::WORDS + offset / 64;
+			auto cursor = cursor_.load(std::memory_order_relaxed);
+			while (word < cursor && !cursor_.compare_exchange_weak(cursor, word, std::memory_order_relaxed)) {};	//Set cursor_ if word is lower.
+		}
+
+		//Adds a block unless another thread already made objects available. Returns false if the shard has GDBASE_OBJECTPOOL_MAX_BLOCKS blocks.
+		bool grow()
+		{
+			std::lock_guard<std::mutex> growGuard(growLock_);
+			if (available_.load() > 0)
+			{
+				return true;
+			}
+
+			auto block = nBlocks_.load();
+			if (block >= GDBASE_OBJECTPOOL_MAX_BLOCKS)
+			{
+				return false;
+			}
+
+			auto newBlock = new ShardBlock<Obj>();
+			for (auto& object : newBlock->objects)
+			{
+				object = defaultObject_;
+			}
+			for (size_t word = 0; word < ShardBlock<Obj>::WORDS; word++)
+			{
+				auto used = word == ShardBlock<Obj>::WORDS - 1 && GDBASE_OBJECTPOOL_BLOCK_SIZE % 64 != 0 ? ~(uint64_t)0 << (GDBASE_OBJECTPOOL_BLOCK_SIZE % 64) : 0;	//Bits past the block size are permanently in use.
+				newBlock->inUse[word].store(used, std::memory_order_relaxed);
+			}
+			blocks_[block] = newBlock;
+			nBlocks_.store(block + 1, std::memory_order_release);
+			available_.fetch_add(GDBASE_OBJECTPOOL_BLOCK_SIZE, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		ShardBlock<Obj>* blocks_[GDBASE_OBJECTPOOL_MAX_BLOCKS];
+		Obj defaultObject_;
+		std::mutex growLock_;
+		std::atomic_size_t nBlocks_;
+		std::atomic_size_t available_;		//Free objects not yet claimed by a reserving thread.
+		std::atomic_size_t cursor_;			//Occupancy word the next search starts from.
+	};
+
+	/*
+		ShardedObjectPool
+		Thread safe object pool split into shards, by default one per hardware thread. Each shard has its own blocks,
+		occupancy bitmap and cursor on its own cache lines, and each thread reserves from the shard it is assigned,
+		so threads on different shards never write the same cache line.
+		A thread whose shard is full takes an object from another shard before its shard grows.
+		Indices are globally unique: the shard an object belongs to is index % shard count, so release() goes straight to it
+		from any thread.
+	*/
+	template <class Obj>
+	class ShardedObjectPool
+	{
+	public:
+		/*
+			ShardedObjectPool Constructor
+			Shards start empty and allocate their blocks on first use, from the thread that uses them.
+			@nShards		Number of shards. Defaults to the number of hardware threads.
+			@defaultObject	Value objects are given when their block is allocated.
+		*/
+		explicit ShardedObjectPool(size_t nShards = defaultShardCount(), const Obj& defaultObject = Obj())
+		{
+			nShards = nShards > 0 ? nShards : 1;
+			for (size_t i = 0; i < nShards; i++)
+			{
+				shards_.push_back(std::make_unique<impl::PoolShard<Obj>>(defaultObject));
+			}
+		}
+
+		ShardedObjectPool(const ShardedObjectPool&) = delete;
+		ShardedObjectPool& operator=(const ShardedObjectPool&) = delete;
+
+		Obj& at(PoolIndex index) { return shards_[index % shards_.size()]->at(index / shards_.size()); }
+		bool isInUse(PoolIndex index) { return shards_[index % shards_.size()]->isInUse(index / shards_.size()); }
+
+		//Reserves one object from the calling thread's shard. Returns the index to the object.
+		PoolIndex reserve() { return reserveFrom(localShard()); }
+
+		/*
+			Reserves one object, preferring the given shard. Returns the index to the object,
+			or GDBASE_INVALID_ID if every shard has reached GDBASE_OBJECTPOOL_MAX_BLOCKS blocks.
+		*/
+		PoolIndex reserveFrom(size_t shard)
+		{
+			for (;;)
+			{
+				auto local = shards_[shard]->tryReserve();
+				if (local != impl::PoolShard<Obj>::NONE)
+				{
+					return toIndex(shard, local);
+				}
+
+				//Steal from the next shard that has anything available.
+				for (size_t i = 1; i < shards_.size(); i++)
+				{
+					auto victim = (shard + i) % shards_.size();
+					if (shards_[victim]->hasAvailable() && (local = shards_[victim]->tryReserve()) != impl::PoolShard<Obj>::NONE)
+					{
+						return toIndex(victim, local);
+					}
+				}
+
+				if (!shards_[shard]->grow())
+				{
+					return GDBASE_INVALID_ID;
+				}
+			}
+		}
+
+		//Releases an object from use. May be called from any thread.
+		void release(PoolIndex index) { shards_[index % shards_.size()]->release(index / shards_.size()); }
+
+		//Shard the object at index belongs to.
+		size_t shardOf(PoolIndex index) const { return index % shards_.size(); }
+
+		//Shard the calling thread reserves from. Threads are spread over the shards in the order they first reserve.
+		size_t localShard() const
+		{
+			static std::atomic_size_t nextThread(0);
+			static thread_local size_t thread = nextThread++;
+			return thread % shards_.size();
+		}
+
+		size_t getShardCount() const { return shards_.size(); }
+
+		//Number of objects allocated across all shards.
+		size_t getCapacity() const
+		{
+			size_t capacity = 0;
+			for (auto& shard : shards_)
+			{
+				capacity += shard->getCapacity();
+			}
+			return capacity;
+		}
+
+		//Number of objects in use. Only exact while no other thread is reserving or releasing.
+		size_t size() const
+		{
+			size_t used = 0;
+			for (auto& shard : shards_)
+			{
+				used += shard->getCapacity() - shard->getAvailable();
+			}
+			return used;
+		}
+
+		static size_t defaultShardCount()
+		{
+			auto threads = std::thread::hardware_concurrency();
+			return threads > 0 ? threads : 1;
+		}
+
+	private:
+		std::vector<std::unique_ptr<impl::PoolShard<Obj>>> shards_;
+
+		PoolIndex toIndex(size_t shard, size_t local) const { return (PoolIndex)(local * shards_.size() + shard); }
+	};
+};
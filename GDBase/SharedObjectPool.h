@@ -0,0 +1,391 @@
+#pragma once
+
+#include "pch.h"
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "ObjectPool.h"
+#include "FixedObjectPool.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX					//Keep windows.h from defining min and max macros in every file including this header.
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define GDBASE_SHARED_POOL_VERSION 1		//Layout version of a SharedObjectPool region. Processes built with another version refuse to attach.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		struct SharedPoolHeader;		//Start of a SharedObjectPool region. Describes where the rest of the region is.
+	}
+
+	template <class Obj>
+	class SharedObjectPool;				//Fixed capacity object pool in a shared memory region other processes can attach to.
+
+	//Class definitions
+	struct impl::SharedPoolHeader
+	{
+		static constexpr uint64_t MAGIC = 0x4744425348504F4FULL;	//"GDBSHPOO"
+
+		std::atomic<uint64_t> magic;		//Stored last by the creator, so attaching processes never see a half built pool.
+		uint32_t version;
+		uint32_t objectSize;				//sizeof(Obj) of the creator, checked on attach.
+		uint32_t objectAlign;
+		uint64_t capacity;
+		uint64_t regionSize;
+		uint64_t occupancyOffset;			//Offsets from the start of the region. Every process maps it at a different address.
+		uint64_t objectsOffset;
+		alignas(GDBASE_CACHE_LINE_SIZE) std::atomic<uint64_t> firstFreeWord;	//Occupancy word reserve() starts searching from.
+	};
+
+	/*
+		SharedObjectPool
+		Object pool living in a named shared memory region (shm_open and mmap, or a file mapping on Windows) so that
+		other processes can read and change its objects without copying them.
+		One process create()s the pool and others attach() to it, optionally read only. The region holds no pointers:
+		the occupancy bitmap and the objects are found through offsets in its header, and occupancy is a bitmap of
+		lock free atomics, which work across processes. The capacity is fixed when the pool is created;
+		reserve() returns GDBASE_INVALID_ID when it is full.
+		Obj must be trivially copyable and must not point into any process's memory.
+		Objects are not locked: readers may see an object while another process is writing it.
+	*/
+	template <class Obj>
+	class SharedObjectPool
+	{
+		static_assert(std::is_trivially_copyable_v<Obj>, "SharedObjectPool objects are shared between processes and must be trivially copyable.");
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "SharedObjectPool needs lock free 64 bit atomics to share them between processes.");
+
+	public:
+		SharedObjectPool() = default;
+
+		~SharedObjectPool() { close(); }
+
+		SharedObjectPool(const SharedObjectPool&) = delete;
+		SharedObjectPool& operator=(const SharedObjectPool&) = delete;
+
+		/*
+			Creates the region and a pool in it. Returns false if the region already exists or cannot be created.
+			The name stays taken until the creating process closes the pool.
+			@name			Name of the region. On POSIX systems a leading '/' is added if missing.
+			@capacity		Number of objects. Fixed for the life of the pool.
+			@defaultObject	Value every object starts with.
+		*/
+		bool create(const std::string& name, size_t capacity, const Obj& defaultObject = Obj())
+		{
+			close();
+			if (capacity == 0 || capacity >= (size_t)GDBASE_INVALID_ID)
+			{
+				return false;
+			}
+
+			auto words = (capacity + 63) / 64;
+			auto occupancyOffset = alignUp(sizeof(impl::SharedPoolHeader), GDBASE_CACHE_LINE_SIZE);
+			auto objectsOffset = alignUp(occupancyOffset + words * sizeof(uint64_t), alignof(Obj) > GDBASE_CACHE_LINE_SIZE ? alignof(Obj) : GDBASE_CACHE_LINE_SIZE);
+			auto regionSize = objectsOffset + capacity * sizeof(Obj);
+			if (!mapRegion(name, regionSize, true, false))
+			{
+				return false;
+			}
+
+			header_ = new (region_) impl::SharedPoolHeader();
+			header_->version = GDBASE_SHARED_POOL_VERSION;
+			header_->objectSize = (uint32_t)sizeof(Obj);
+			header_->objectAlign = (uint32_t)alignof(Obj);
+			header_->capacity = capacity;
+			header_->regionSize = regionSize;
+			header_->occupancyOffset = occupancyOffset;
+			header_->objectsOffset = objectsOffset;
+			header_->firstFreeWord.store(0, std::memory_order_relaxed);
+
+			inUse_ = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(region_) + occupancyOffset);
+			objects_ = reinterpret_cast<Obj*>(static_cast<char*>(region_) + objectsOffset);
+			for (size_t word = 0; word < words; word++)
+			{
+				new (&inUse_[word]) std::atomic<uint64_t>(word == words - 1 ? ~lastWordMask(capacity) : 0);	//Bits past capacity are permanently in use.
+			}
+			for (size_t i = 0; i < capacity; i++)
+			{
+				std::memcpy(static_cast<void*>(&objects_[i]), &defaultObject, sizeof(Obj));
+			}
+			capacity_ = capacity;
+			owner_ = true;
+
+			header_->magic.store(impl::SharedPoolHeader::MAGIC, std::memory_order_release);
+			return true;
+		}
+
+		/*
+			Attaches to a pool created by another SharedObjectPool, usually in another process.
+			Returns false if the region does not exist, is still being created, or holds a pool of another object type or layout version.
+			@readOnly	Maps the region read only. reserve() and release() then do nothing and objects must only be accessed through read().
+		*/
+		bool attach(const std::string& name, bool readOnly = false)
+		{
+			close();
+			if (!mapRegion(name, 0, false, readOnly))
+			{
+				return false;
+			}
+
+			header_ = static_cast<impl::SharedPoolHeader*>(region_);
+			if (regionSize_ < sizeof(impl::SharedPoolHeader) || header_->magic.load(std::memory_order_acquire) != impl::SharedPoolHeader::MAGIC ||
+				header_->version != GDBASE_SHARED_POOL_VERSION || header_->objectSize != sizeof(Obj) || header_->objectAlign != alignof(Obj) ||
+				header_->regionSize > regionSize_)
+			{
+				close();
+				return false;
+			}
+
+			inUse_ = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(region_) + header_->occupancyOffset);
+			objects_ = reinterpret_cast<Obj*>(static_cast<char*>(region_) + header_->objectsOffset);
+			capacity_ = (size_t)header_->capacity;
+			readOnly_ = readOnly;
+			return true;
+		}
+
+		//Unmaps the region. If this process created the pool its name is removed; processes still attached keep their mapping.
+		void close()
+		{
+			if (region_ == nullptr)
+			{
+				return;
+			}
+
+#ifdef _WIN32
+			UnmapViewOfFile(region_);
+			CloseHandle(mapping_);
+			mapping_ = nullptr;
+#else
+			munmap(region_, regionSize_);
+			if (owner_)
+			{
+				shm_unlink(name_.c_str());
+			}
+#endif
+			region_ = nullptr;
+			header_ = nullptr;
+			inUse_ = nullptr;
+			objects_ = nullptr;
+			regionSize_ = 0;
+			capacity_ = 0;
+			owner_ = false;
+			readOnly_ = false;
+		}
+
+		/*
+			Removes a region left behind by a process that exited without closing its pool. Does nothing on Windows,
+			where the region goes away with the last process that has it open.
+		*/
+		static void remove(const std::string& name)
+		{
+#ifndef _WIN32
+			shm_unlink(regionName(name).c_str());
+#endif
+		}
+
+		bool isOpen() const { return region_ != nullptr; }
+		bool isOwner() const { return owner_; }
+		bool isReadOnly() const { return readOnly_; }
+		size_t capacity() const { return capacity_; }
+
+		bool isInUse(PoolIndex index) const { return index < capacity_ && (inUse_[index / 64].load(std::memory_order_acquire) & bit(index)) != 0; }
+		Obj& at(PoolIndex index) { return objects_[index]; }
+		const Obj& read(PoolIndex index) const { return objects_[index]; }
+
+		//Reserves one object. Returns the index to the object, or GDBASE_INVALID_ID if the pool is full or read only.
+		PoolIndex reserve()
+		{
+			if (readOnly_)
+			{
+				return GDBASE_INVALID_ID;
+			}
+
+			auto words = wordCount();
+			auto first = (size_t)header_->firstFreeWord.load(std::memory_order_relaxed);
+			for (size_t n = 0; n < words; n++)
+			{
+				auto word = (first + n) % words;
+				auto bits = inUse_[word].load(std::memory_order_relaxed);
+				while (~bits != 0)
+				{
+					auto free = impl::countTrailingZeros(~bits);
+					if (inUse_[word].compare_exchange_weak(bits, bits | ((uint64_t)1 << free), std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						if (word != first)		//Words before this one were full. Move the hint forward if nobody else has moved it.
+						{
+							uint64_t expected = first;
+							header_->firstFreeWord.compare_exchange_strong(expected, word, std::memory_order_relaxed);
+						}
+						return (PoolIndex)(word * 64 + free);
+					}
+				}
+			}
+			return GDBASE_INVALID_ID;
+		}
+
+		//Releases an object from use.
+		void release(PoolIndex index)
+		{
+			if (readOnly_)
+			{
+				return;
+			}
+
+			inUse_[index / 64].fetch_and(~bit(index), std::memory_order_release);
+			uint64_t word = index / 64;
+			auto first = header_->firstFreeWord.load(std::memory_order_relaxed);
+			while (word < first && !header_->firstFreeWord.compare_exchange_weak(first, word, std::memory_order_relaxed)) {};	//Set firstFreeWord if word is lower.
+		}
+
+		//Number of objects in use.
+		size_t size() const
+		{
+			size_t count = 0;
+			for (size_t word = 0; word < wordCount(); word++)
+			{
+				count += impl::popCount(usedBits(word));
+			}
+			return count;
+		}
+
+		//Calls fn(index, object) for every object in use, in index order. Safe on read only pools.
+		template <class F>
+		void forEach(F&& fn) const
+		{
+			for (size_t word = 0; word < wordCount(); word++)
+			{
+				for (auto bits = usedBits(word); bits != 0; bits &= bits - 1)
+				{
+					auto index = (PoolIndex)(word * 64 + impl::countTrailingZeros(bits));
+					fn(index, static_cast<const Obj&>(objects_[index]));
+				}
+			}
+		}
+
+	private:
+		void* region_ = nullptr;
+		size_t regionSize_ = 0;
+		impl::SharedPoolHeader* header_ = nullptr;
+		std::atomic<uint64_t>* inUse_ = nullptr;
+		Obj* objects_ = nullptr;
+		size_t capacity_ = 0;
+		bool owner_ = false;
+		bool readOnly_ = false;
+		std::string name_;
+#ifdef _WIN32
+		HANDLE mapping_ = nullptr;
+#endif
+
+		static size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+		static uint64_t bit(size_t index) { return (uint64_t)1 << (index % 64); }
+		static uint64_t lastWordMask(size_t capacity) { return capacity % 64 == 0 ? ~(uint64_t)0 : ((uint64_t)1 << (capacity % 64)) - 1; }
+
+		size_t wordCount() const { return (capacity_ + 63) / 64; }
+
+		uint64_t usedBits(size_t word) const
+		{
+			auto bits = inUse_[word].load(std::memory_order_acquire);
+			return word == wordCount() - 1 ? bits & lastWordMask(capacity_) : bits;
+		}
+
+		static std::string regionName(const std::string& name)
+		{
+#ifdef _WIN32
+			return name;
+#else
+			return !name.empty() && name[0] == '/' ? name : "/" + name;
+#endif
+		}
+
+		/*
+			Creates or opens the named region and maps all of it, setting region_ and regionSize_.
+			@size	Size of the region to create. Ignored when opening an existing one.
+		*/
+		bool mapRegion(const std::string& name, size_t size, bool create, bool readOnly)
+		{
+			name_ = regionName(name);
+#ifdef _WIN32
+			if (create)
+			{
+				mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name_.c_str());
+				if (mapping_ != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+				{
+					CloseHandle(mapping_);
+					mapping_ = nullptr;
+				}
+			}
+			else
+			{
+				mapping_ = OpenFileMappingA(readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, FALSE, name_.c_str());
+			}
+			if (mapping_ == nullptr)
+			{
+				return false;
+			}
+
+			region_ = MapViewOfFile(mapping_, readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, 0);
+			MEMORY_BASIC_INFORMATION info;
+			if (region_ == nullptr || VirtualQuery(region_, &info, sizeof(info)) == 0)
+			{
+				if (region_ != nullptr)
+				{
+					UnmapViewOfFile(region_);
+					region_ = nullptr;
+				}
+				CloseHandle(mapping_);
+				mapping_ = nullptr;
+				return false;
+			}
+			regionSize_ = info.RegionSize;
+#else
+			auto fd = create ? shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600) : shm_open(name_.c_str(), readOnly ? O_RDONLY : O_RDWR, 0);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			struct stat info;
+			if ((create && ftruncate(fd, (off_t)size) != 0) || fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				::close(fd);
+				if (create)
+				{
+					shm_unlink(name_.c_str());
+				}
+				return false;
+			}
+
+			auto mapped = mmap(nullptr, (size_t)info.st_size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);		//The mapping keeps the region alive.
+			if (mapped == MAP_FAILED)
+			{
+				if (create)
+				{
+					shm_unlink(name_.c_str());
+				}
+				return false;
+			}
+			region_ = mapped;
+			regionSize_ = (size_t)info.st_size;
+#endif
+			return true;
+		}
+	};
+};
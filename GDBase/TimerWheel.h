@@ -0,0 +1,340 @@
+#pragma once
+
+#include "pch.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "ObjectPool.h"
+#include "FixedObjectPool.h"
+
+#define GDBASE_TIMERWHEEL_SLOT_BITS 8		//Each wheel has 2^GDBASE_TIMERWHEEL_SLOT_BITS slots. At least 6.
+#define GDBASE_TIMERWHEEL_LEVELS 4			//Number of wheels. Timers further away than 2^(SLOT_BITS * LEVELS) ticks wait in an overflow list.
+
+namespace GDBase
+{
+	//Class declarations
+	namespace impl
+	{
+		template <class Payload>
+		struct TimerNode;				//Pooled timer record, linked into one bucket of the wheel.
+	}
+
+	struct TimerHandle;					//Refers to a timer until it fires or is cancelled.
+
+	template <class Payload>
+	class TimerWheel;					//Hierarchical timing wheel of pooled timers.
+
+	//Class definitions
+	struct TimerHandle
+	{
+		PoolIndex index = GDBASE_INVALID_ID;
+		uint32_t generation = 0;		//Timer records are reused; a handle goes stale once its record's generation moves on.
+
+		bool isValid() const { return index != GDBASE_INVALID_ID; }
+	};
+
+	template <class Payload>
+	struct impl::TimerNode
+	{
+		uint64_t expiry = 0;			//Tick the timer fires on.
+		PoolIndex next = GDBASE_INVALID_ID;
+		PoolIndex previous = GDBASE_INVALID_ID;
+		uint32_t generation = 0;
+		uint32_t bucket = UINT32_MAX;	//Bucket the node is linked into, UINT32_MAX while it is not linked.
+		Payload payload;
+	};
+
+	/*
+		TimerWheel
+		Hierarchical timing wheel. Wheel 0 has one slot per tick; each slot of wheel n covers a whole turn of wheel n - 1.
+		A timer sits in the wheel of the highest digit in which its expiry differs from the current tick and moves down
+		a wheel each time that wheel's slot comes up, so scheduling, cancelling and rescheduling are O(1).
+		Timer records come from an ObjectPool and each bucket is a doubly linked list of pool indices threaded through them,
+		so timers are never allocated one at a time.
+		advance() jumps straight to the next tick that has something to do, using a bitmap of the occupied slots of each wheel.
+		Not thread safe.
+	*/
+	template <class Payload>
+	class TimerWheel
+	{
+		static_assert(GDBASE_TIMERWHEEL_SLOT_BITS >= 6, "TimerWheel slots must fill whole 64 bit occupancy words.");
+		static_assert(GDBASE_TIMERWHEEL_SLOT_BITS * GDBASE_TIMERWHEEL_LEVELS < 64, "TimerWheel range must fit in a 64 bit tick.");
+
+	public:
+		/*
+			TimerWheel Constructor
+			@initialSize	Number of timer records allocated up front rounded up to the nearest block size specified by GDBASE_OBJECTPOOL_BLOCK_SIZE
+		*/
+		explicit TimerWheel(size_t initialSize = 1000) : nodes_(initialSize), now_(0), pending_(0)
+		{
+			heads_.assign(BUCKETS, GDBASE_INVALID_ID);
+			occupied_.assign(LEVELS * WORDS, 0);
+		}
+
+		//Current tick. Starts at 0.
+		uint64_t now() const { return now_; }
+
+		//Number of timers waiting to fire.
+		size_t size() const { return pending_; }
+		bool isEmpty() const { return pending_ == 0; }
+
+		/*
+			Schedules a timer that fires once delay ticks have been advanced.
+			@delay	Ticks from now. 0 fires on the next tick.
+		*/
+		TimerHandle schedule(uint64_t delay, const Payload& payload)
+		{
+			auto index = nodes_.reserve();
+			auto& node = nodes_.at(index);
+			node.expiry = now_ + (delay > 0 ? delay : 1);
+			node.payload = payload;
+			link(index);
+			pending_++;
+			return TimerHandle{ index, node.generation };
+		}
+
+		bool isPending(TimerHandle timer) { return isCurrent(timer) && nodes_.at(timer.index).bucket != UINT32_MAX; }
+
+		//Returns nullptr if the timer has fired or been cancelled.
+		Payload* tryGet(TimerHandle timer) { return isCurrent(timer) ? &nodes_.at(timer.index).payload : nullptr; }
+
+		//Stops the timer. Returns false if it already fired or was cancelled.
+		bool cancel(TimerHandle timer)
+		{
+			if (!isPending(timer))
+			{
+				return false;
+			}
+
+			unlink(timer.index);
+			recycle(timer.index);
+			pending_--;
+			return true;
+		}
+
+		/*
+			Moves the timer to fire delay ticks from now. Returns false if it already fired or was cancelled.
+			May be called on the timer being fired from inside advance()'s callback to make it fire again.
+		*/
+		bool reschedule(TimerHandle timer, uint64_t delay)
+		{
+			if (!isCurrent(timer))
+			{
+				return false;
+			}
+
+			auto& node = nodes_.at(timer.index);
+			if (node.bucket != UINT32_MAX)
+			{
+				unlink(timer.index);
+			}
+			else
+			{
+				pending_++;		//Being fired; it is pending again.
+			}
+			node.expiry = now_ + (delay > 0 ? delay : 1);
+			link(timer.index);
+			return true;
+		}
+
+		/*
+			Advances time by ticks, calling fn(TimerHandle, Payload&) for every timer that expires, in tick order.
+			Timers expiring on the same tick fire in no particular order. fn may schedule, cancel and reschedule timers.
+			Returns the number of timers fired.
+		*/
+		template <class F>
+		size_t advance(uint64_t ticks, F&& fn)
+		{
+			size_t fired = 0;
+			auto target = now_ + ticks;
+			while (now_ < target)
+			{
+				now_ = nextEvent(target);
+
+				//Bring timers down from the higher wheels before firing this tick's slot.
+				if ((now_ & (RANGE - 1)) == 0)
+				{
+					cascade(OVERFLOW_BUCKET);
+				}
+				for (auto level = LEVELS - 1; level > 0; level--)
+				{
+					auto shift = level * SLOT_BITS;
+					if ((now_ & (((uint64_t)1 << shift) - 1)) == 0)
+					{
+						cascade(level * SLOTS + ((now_ >> shift) & SLOT_MASK));
+					}
+				}
+				fired += fire(now_ & SLOT_MASK, fn);
+			}
+			return fired;
+		}
+
+	private:
+		static constexpr size_t SLOT_BITS = GDBASE_TIMERWHEEL_SLOT_BITS;
+		static constexpr size_t LEVELS = GDBASE_TIMERWHEEL_LEVELS;
+		static constexpr size_t SLOTS = (size_t)1 << SLOT_BITS;
+		static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+		static constexpr size_t WORDS = SLOTS / 64;						//Occupancy words per wheel.
+		static constexpr size_t OVERFLOW_BUCKET = LEVELS * SLOTS;
+		static constexpr size_t BUCKETS = LEVELS * SLOTS + 1;
+		static constexpr uint64_t RANGE = (uint64_t)1 << (SLOT_BITS * LEVELS);	//Ticks covered by all wheels.
+
+		ObjectPool<impl::TimerNode<Payload>> nodes_;
+		std::vector<PoolIndex> heads_;			//First node of each bucket. Wheel after wheel, then the overflow list.
+		std::vector<uint64_t> occupied_;		//One bit per slot of each wheel, set while its bucket is not empty.
+		uint64_t now_;
+		size_t pending_;
+
+		bool isCurrent(TimerHandle timer) { return timer.isValid() && nodes_.isInUse(timer.index) && nodes_.at(timer.index).generation == timer.generation; }
+
+		//Bucket a timer expiring at expiry belongs in at the current tick.
+		size_t bucketOf(uint64_t expiry) const
+		{
+			if (expiry <= now_)
+			{
+				return now_ & SLOT_MASK;		//Due; fires with the current tick.
+			}
+
+			auto differs = expiry ^ now_;
+			for (size_t level = 0; level < LEVELS; level++)
+			{
+				if ((differs >> ((level + 1) * SLOT_BITS)) == 0)
+				{
+					return level * SLOTS + ((expiry >> (level * SLOT_BITS)) & SLOT_MASK);
+				}
+			}
+			return OVERFLOW_BUCKET;
+		}
+
+		void link(PoolIndex index)
+		{
+			auto& node = nodes_.at(index);
+			auto bucket = bucketOf(node.expiry);
+			node.bucket = (uint32_t)bucket;
+			node.previous = GDBASE_INVALID_ID;
+			node.next = heads_[bucket];
+			if (node.next != GDBASE_INVALID_ID)
+			{
+				nodes_.at(node.next).previous = index;
+			}
+			heads_[bucket] = index;
+			if (bucket != OVERFLOW_BUCKET)
+			{
+				occupied_[bucket / 64] |= (uint64_t)1 << (bucket % 64);
+			}
+		}
+
+		void unlink(PoolIndex index)
+		{
+			auto& node = nodes_.at(index);
+			if (node.previous != GDBASE_INVALID_ID)
+			{
+				nodes_.at(node.previous).next = node.next;
+			}
+			else
+			{
+				heads_[node.bucket] = node.next;
+				if (node.next == GDBASE_INVALID_ID && node.bucket != OVERFLOW_BUCKET)
+				{
+					occupied_[node.bucket / 64] &= ~((uint64_t)1 << (node.bucket % 64));
+				}
+			}
+			if (node.next != GDBASE_INVALID_ID)
+			{
+				nodes_.at(node.next).previous = node.previous;
+			}
+			node.bucket = UINT32_MAX;
+		}
+
+		//Invalidates handles to the node and returns it to the pool.
+		void recycle(PoolIndex index)
+		{
+			nodes_.at(index).generation++;
+			nodes_.release(index);
+		}
+
+		//Empties bucket and links its timers again relative to the current tick, which moves them to lower wheels.
+		void cascade(size_t bucket)
+		{
+			auto index = heads_[bucket];
+			if (index == GDBASE_INVALID_ID)
+			{
+				return;
+			}
+
+			heads_[bucket] = GDBASE_INVALID_ID;
+			if (bucket != OVERFLOW_BUCKET)
+			{
+				occupied_[bucket / 64] &= ~((uint64_t)1 << (bucket % 64));
+			}
+			while (index != GDBASE_INVALID_ID)
+			{
+				auto next = nodes_.at(index).next;
+				link(index);
+				index = next;
+			}
+		}
+
+		template <class F>
+		size_t fire(size_t bucket, F& fn)
+		{
+			size_t fired = 0;
+			PoolIndex index;
+			while ((index = heads_[bucket]) != GDBASE_INVALID_ID)	//Taken from the head each time since fn may cancel other timers in the bucket.
+			{
+				unlink(index);
+				pending_--;
+				fired++;
+
+				auto& node = nodes_.at(index);
+				fn(TimerHandle{ index, node.generation }, node.payload);
+				if (node.bucket == UINT32_MAX)	//Not rescheduled by fn.
+				{
+					recycle(index);
+				}
+			}
+			return fired;
+		}
+
+		//First tick after now and no later than target on which a slot has timers to fire or move down.
+		uint64_t nextEvent(uint64_t target) const
+		{
+			auto next = target;
+			for (size_t level = 0; level < LEVELS; level++)
+			{
+				//Timers in a wheel are always in slots after the current tick's slot of that wheel, within the same turn.
+				auto shift = level * SLOT_BITS;
+				auto slot = nextOccupied(level, ((now_ >> shift) & SLOT_MASK) + 1);
+				if (slot < SLOTS)
+				{
+					auto turn = (now_ >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+					next = (std::min)(next, turn + ((uint64_t)slot << shift));
+				}
+			}
+			if (heads_[OVERFLOW_BUCKET] != GDBASE_INVALID_ID)
+			{
+				next = (std::min)(next, (now_ / RANGE + 1) * RANGE);
+			}
+			return next;
+		}
+
+		//First occupied slot of the wheel at or after from, or SLOTS if there is none.
+		size_t nextOccupied(size_t level, size_t from) const
+		{
+			for (auto word = from / 64; word < WORDS; word++)
+			{
+				auto bits = occupied_[level * WORDS + word];
+				if (word == from / 64)
+				{
+					bits &= ~(uint64_t)0 << (from % 64);	//Skip slots before from.
+				}
+				if (bits != 0)
+				{
+					return word * 64 + impl::countTrailingZeros(bits);
+				}
+			}
+			return SLOTS;
+		}
+	};
+};
@@ -2,9 +2,23 @@
 #include "CppUnitTest.h"
 #include "../GDBase/ObjectPool.h"
 #include "../GDBase/AutoObjectPool.h"
+#include "../GDBase/AsyncLogger.h"
+#include "../GDBase/RollbackObjectPool.h"
+#include "../GDBase/ResourceCache.h"
+#include "../GDBase/MessageQueue.h"
+#include "../GDBase/JobScheduler.h"
+#include "../GDBase/FixedObjectPool.h"
+#include "../GDBase/EntityRegistry.h"
+#include "../GDBase/FrameObjectPool.h"
+#include "../GDBase/SharedObjectPool.h"
+#include "../GDBase/TimerWheel.h"
+#include "../GDBase/IndexMap.h"
+#include "../GDBase/ShardedObjectPool.h"
 #include "TestClasses.h"
 #include <iostream>
 #include <thread>
+#include <sstream>
+#include <stdexcept>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -112,12 +126,12 @@ namespace GDBaseTests
 			auto ids = pool.reserveMultiple(400);
 			auto ids2 = pool.reserveMultiple(300);
 
-			for (size_t i = 0; i < 400; i++)
+			for (GDBase::PoolIndex i = 0; i < 400; i++)
 			{
 				Assert::AreEqual(ids[i], i);
 			}
 
-			for (size_t i = 0; i < 300; i++)
+			for (GDBase::PoolIndex i = 0; i < 300; i++)
 			{
 				Assert::AreEqual(ids2[i], i + 400);
 			}
@@ -132,7 +146,7 @@ namespace GDBaseTests
 		TEST_METHOD(TestReserveMultipleArrayMass)
 		{
 			GDBase::ObjectPool<std::string> pool;
-			size_t* ids;
+			GDBase::PoolIndex* ids;
 			pool.reserveMultiple(ids, 5000);
 		}
 
@@ -167,11 +181,40 @@ namespace GDBaseTests
 
 			auto ids2 = pool.reserveMultiple(25);
 
-			for (size_t i = 0; i < 25; i++)
+			for (GDBase::PoolIndex i = 0; i < 25; i++)
 			{
 				Assert::AreEqual(ids2[i], i * 4);
 			}
 		}
+
+		TEST_METHOD(TestReserveReleaseThreads)
+		{
+			GDBase::ObjectPool<int> pool;
+			std::vector<std::atomic_int> holders(GDBASE_OBJECTPOOL_BLOCK_SIZE);	//Only a few objects are held at once, so ids stay in the first block.
+			std::atomic_int duplicates(0);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&pool, &holders, &duplicates]()
+				{
+					for (int i = 0; i < 20000; i++)
+					{
+						auto id = pool.reserve();
+						if (holders[id].fetch_add(1) != 0)	//Another thread holds the same object.
+						{
+							duplicates++;
+						}
+						holders[id].fetch_sub(1);
+						pool.release(id);
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			Assert::AreEqual(duplicates.load(), 0);
+		}
 	};
 
 	TEST_CLASS(AutoObjectPoolTests)
@@ -198,17 +241,17 @@ namespace GDBaseTests
 			auto pool = new AutoObjectPool<std::string>(v);
 			{
 				auto obj = pool->makePoolObject();
-				Assert::AreEqual(obj.getID(), (size_t)0);
+				Assert::AreEqual(obj.getID(), (GDBase::PoolIndex)0);
 				auto obj2 = pool->makePoolObject();
-				Assert::AreEqual(obj2.getID(), (size_t)1);
+				Assert::AreEqual(obj2.getID(), (GDBase::PoolIndex)1);
 				auto obj3 = pool->makePoolObject();
-				Assert::AreEqual(obj3.getID(), (size_t)2);
+				Assert::AreEqual(obj3.getID(), (GDBase::PoolIndex)2);
 				auto obj4 = pool->makePoolObject();
-				Assert::AreEqual(obj4.getID(), (size_t)3);
-				log.log(obj.getID());
-				log.log(obj2.getID());
-				log.log(obj3.getID());
-				log.log(obj4.getID());
+				Assert::AreEqual(obj4.getID(), (GDBase::PoolIndex)3);
+				log.log((size_t)obj.getID());
+				log.log((size_t)obj2.getID());
+				log.log((size_t)obj3.getID());
+				log.log((size_t)obj4.getID());
 
 				Assert::AreNotEqual(obj.getID(), obj2.getID());
 				Assert::AreNotEqual(obj.getID(), obj3.getID());
@@ -250,7 +293,7 @@ namespace GDBaseTests
 			auto pool = new AutoObjectPool<std::string>();
 			std::vector<GDBase::PoolObject<std::string>> vec;
 			pool->makePoolObjects(vec, 1000);
-			for(size_t i = 0; i < 1000; i++)
+			for(GDBase::PoolIndex i = 0; i < 1000; i++)
 			{
 				Assert::AreEqual(vec[i].getID(), i);
 			}
@@ -284,19 +327,19 @@ namespace GDBaseTests
 			std::string v = "asdf";
 			auto pool = new AutoObjectPool<std::string>(v);
 			ObjWrapper* a = new ObjWrapper(pool->makePoolObject());
-			Assert::AreEqual(a->obj.getID(), (size_t)0);
+			Assert::AreEqual(a->obj.getID(), (GDBase::PoolIndex)0);
 			ObjWrapper* b = new ObjWrapper(pool->makePoolObject());
-			Assert::AreEqual(b->obj.getID(), (size_t)1);
+			Assert::AreEqual(b->obj.getID(), (GDBase::PoolIndex)1);
 
 			delete a;
 			
 			ObjWrapper* c = new ObjWrapper(pool->makePoolObject());
 			a = new ObjWrapper(pool->makePoolObject());
 
-			Assert::AreEqual(c->obj.getID(), (size_t)0);
-			Assert::AreEqual(b->obj.getID(), (size_t)1);
-			log.log(a->obj.getID());
-			Assert::AreEqual(a->obj.getID(), (size_t)2);
+			Assert::AreEqual(c->obj.getID(), (GDBase::PoolIndex)0);
+			Assert::AreEqual(b->obj.getID(), (GDBase::PoolIndex)1);
+			log.log((size_t)a->obj.getID());
+			Assert::AreEqual(a->obj.getID(), (GDBase::PoolIndex)2);
 		}
 
 
@@ -306,7 +349,7 @@ namespace GDBaseTests
 			auto pool = new AutoObjectPool<std::string>(v, 10);
 			std::vector<GDBase::PoolObject<std::string>> objects;
 
-			for (size_t i = 0; i < 3000; i++)
+			for (GDBase::PoolIndex i = 0; i < 3000; i++)
 			{
 				objects.push_back(pool->makePoolObject());
 				Assert::AreEqual(objects[i].getID(), i);
@@ -329,4 +372,1287 @@ namespace GDBaseTests
 			Assert::AreEqual(pool->isInUse(1), false);
 		}
 	};
+
+	TEST_CLASS(AsyncLoggerTests)
+	{
+	public:
+		TEST_METHOD(TestLogFormat)
+		{
+			std::ostringstream out;
+			GDBase::AsyncLogger logger(out);
+			std::string str = "str";
+			logger.log("a", 1, ' ', (size_t)2);
+			logger.logln(str, 3.5);
+			logger.nl();
+			logger.flush();
+
+			Assert::AreEqual(out.str(), std::string("a1 2str3.5\n\n"));
+		}
+
+		TEST_METHOD(TestThreadCacheDropsDestroyed)
+		{
+			size_t cached = 0;
+			std::thread([&cached]()
+			{
+				std::ostringstream out;
+				for (int i = 0; i < 50; i++)
+				{
+					GDBase::AsyncLogger logger(out);
+					logger.logln(i);
+				}
+				GDBase::AsyncLogger last(out);
+				last.nl();
+				cached = GDBase::impl::LogThreadCache::current().size();
+			}).join();
+			Assert::AreEqual(cached, (size_t)1);
+		}
+
+		TEST_METHOD(TestLogThreads)
+		{
+			std::ostringstream out;
+			GDBase::AsyncLogger logger(out, GDBase::LogOverflowPolicy::Block, 256);
+			std::vector<std::thread> threads;
+
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&logger, t]()
+				{
+					for (int i = 0; i < 1000; i++)
+					{
+						logger.logln(t, ":", i);
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			logger.flush();
+
+			//Every line is present and lines from a thread stay in order.
+			std::istringstream in(out.str());
+			std::string line;
+			int next[4] = { 0, 0, 0, 0 };
+			while (std::getline(in, line))
+			{
+				auto split = line.find(':');
+				auto t = std::stoi(line.substr(0, split));
+				Assert::AreEqual(std::stoi(line.substr(split + 1)), next[t]++);
+			}
+			for (int t = 0; t < 4; t++)
+			{
+				Assert::AreEqual(next[t], 1000);
+			}
+			Assert::AreEqual(logger.droppedCount(), (size_t)0);
+		}
+
+		TEST_METHOD(TestLogDrop)
+		{
+			std::ostringstream out;
+			size_t written = 0;
+			{
+				GDBase::AsyncLogger logger(out, GDBase::LogOverflowPolicy::Drop, 64);
+				for (int i = 0; i < 1000; i++)
+				{
+					written += logger.logln(i) ? 1 : 0;
+				}
+				logger.flush();
+				Assert::AreEqual(written + logger.droppedCount(), (size_t)1000);
+			}
+
+			std::istringstream in(out.str());
+			std::string line;
+			size_t lines = 0;
+			while (std::getline(in, line))
+			{
+				lines++;
+			}
+			Assert::AreEqual(lines, written);
+		}
+	};
+
+	TEST_CLASS(RollbackObjectPoolTests)
+	{
+	public:
+		TEST_METHOD(TestRestoreObjects)
+		{
+			GDBase::RollbackObjectPool<int> pool;
+			auto id = pool.reserve();
+			pool.at(id) = 1;
+			auto frame1 = pool.snapshot();
+			pool.at(id) = 2;
+			auto frame2 = pool.snapshot();
+			pool.at(id) = 3;
+
+			Assert::AreEqual(pool.restore(frame2), true);
+			Assert::AreEqual(pool.read(id), 2);
+			Assert::AreEqual(pool.restore(frame1), true);
+			Assert::AreEqual(pool.read(id), 1);
+			Assert::AreEqual(pool.hasFrame(frame2), false);
+		}
+
+		TEST_METHOD(TestRestoreOccupancy)
+		{
+			GDBase::RollbackObjectPool<int> pool;
+			pool.reserveMultiple(10);
+			auto frame = pool.snapshot();
+			pool.release(3);
+			pool.reserveMultiple(2000);
+			pool.snapshot();
+			pool.release(5);
+
+			Assert::AreEqual(pool.restore(frame), true);
+			Assert::AreEqual(pool.isInUse(3), true);
+			Assert::AreEqual(pool.isInUse(5), true);
+			Assert::AreEqual(pool.isInUse(10), false);
+			Assert::AreEqual(pool.isInUse(1500), false);
+			Assert::AreEqual(pool.reserve(), (GDBase::PoolIndex)10);
+		}
+
+		TEST_METHOD(TestSnapshotOnlyDirtyBlocks)
+		{
+			GDBase::RollbackObjectPool<int> pool(5000, 4);
+			auto frame = pool.snapshot();
+			for (int tick = 0; tick < 10; tick++)
+			{
+				pool.at(4500) = tick;
+				pool.snapshot();
+			}
+
+			Assert::AreEqual(pool.frameCount(), (size_t)4);
+			Assert::AreEqual(pool.hasFrame(frame), false);
+			Assert::AreEqual(pool.restore(pool.latestFrame() - 3), true);
+			Assert::AreEqual(pool.read(4500), 6);
+		}
+	};
+
+	TEST_CLASS(ResourceCacheTests)
+	{
+	public:
+		TEST_METHOD(TestGetLoadsOnce)
+		{
+			GDBase::ResourceCache<int, std::string> cache;
+			int loads = 0;
+			auto load = [&loads](int key) { loads++; return std::to_string(key); };
+
+			auto obj = cache.get(5, load);
+			auto obj2 = cache.get(5, load);
+			Assert::AreEqual(*obj, std::string("5"));
+			Assert::AreEqual(obj.getID(), obj2.getID());
+			Assert::AreEqual(loads, 1);
+		}
+
+		TEST_METHOD(TestUnreferencedStaysResident)
+		{
+			GDBase::ResourceCache<int, std::string> cache;
+			GDBase::PoolIndex id;
+			{
+				auto obj = cache.get(1, [](int) { return std::string("one"); });
+				id = obj.getID();
+			}
+			Assert::AreEqual(cache.idleCount(), (size_t)1);
+
+			auto found = cache.find(1);
+			Assert::AreEqual(found.has_value(), true);
+			Assert::AreEqual(found->getID(), id);
+			Assert::AreEqual(**found, std::string("one"));
+			Assert::AreEqual(cache.idleCount(), (size_t)0);
+		}
+
+		TEST_METHOD(TestEvictIdle)
+		{
+			GDBase::ResourceCache<int, std::string> cache(2);
+			auto kept = cache.get(0, [](int) { return std::string("kept"); });
+			for (int key = 1; key <= 5; key++)
+			{
+				cache.get(key, [](int key) { return std::to_string(key); });
+			}
+
+			Assert::AreEqual(cache.idleCount(), (size_t)2);
+			Assert::AreEqual(cache.contains(0), true);
+			Assert::AreEqual(cache.clear(), (size_t)2);
+			Assert::AreEqual(cache.find(3).has_value(), false);
+			Assert::AreEqual(cache.contains(0), true);
+		}
+
+		TEST_METHOD(TestGetThreads)
+		{
+			GDBase::ResourceCache<int, int> cache(100);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&cache]()
+				{
+					for (int i = 0; i < 5000; i++)
+					{
+						auto obj = cache.get(i % 300, [](int key) { return key * 2; });
+						Assert::AreEqual(*obj, (i % 300) * 2);
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			Assert::AreEqual(cache.idleCount() <= 100, true);
+		}
+
+		struct SameShardHash
+		{
+			size_t operator()(int) const { return 0; }
+		};
+
+		TEST_METHOD(TestLoaderUsesCache)
+		{
+			//Every key is in the same shard, and the idle object dropped by the loader is evicted while it runs.
+			GDBase::ResourceCache<int, int, SameShardHash> cache(0);
+			auto material = cache.get(1, [&cache](int key)
+			{
+				auto texture = cache.get(2, [](int key) { return key * 10; });
+				cache.get(3, [](int key) { return key * 10; });
+				return key + *texture;
+			});
+			Assert::AreEqual(*material, 21);
+			Assert::AreEqual(cache.contains(2), false);
+		}
+
+		struct Node
+		{
+			int value;
+			GDBase::PoolObject<Node> dependency;	//Keeps another resource of the same cache resident.
+		};
+
+		static GDBase::PoolObject<Node> getNode(GDBase::ResourceCache<int, Node>& cache, int key)
+		{
+			return cache.get(key, [&cache](int key)
+			{
+				return key > 0 ? Node{ key, getNode(cache, key - 1) } : Node{ key, GDBase::PoolObject<Node>() };
+			});
+		}
+
+		TEST_METHOD(TestEvictDependent)
+		{
+			//Evicting the parent releases its dependencies, which are evicted in turn.
+			GDBase::ResourceCache<int, Node> cache(0);
+			{
+				auto parent = getNode(cache, 3);
+				Assert::AreEqual(parent->dependency->value, 2);
+			}
+			Assert::AreEqual(cache.contains(0), false);
+			Assert::AreEqual(cache.idleCount(), (size_t)0);
+		}
+
+		TEST_METHOD(TestDestroyDependent)
+		{
+			//Idle objects holding dependencies are evicted while the cache is still whole.
+			GDBase::ResourceCache<int, Node> cache(1000);
+			getNode(cache, 1);
+			Assert::AreEqual(cache.idleCount(), (size_t)1);
+		}
+
+		TEST_METHOD(TestLoadThrows)
+		{
+			GDBase::ResourceCache<int, int> cache;
+			bool thrown = false;
+			try
+			{
+				cache.get(4, [](int) -> int { throw std::runtime_error("missing"); });
+			}
+			catch (const std::runtime_error&)
+			{
+				thrown = true;
+			}
+			Assert::AreEqual(thrown, true);
+			Assert::AreEqual(cache.contains(4), false);
+
+			auto obj = cache.get(4, [](int key) { return key * 2; });
+			Assert::AreEqual(*obj, 8);
+		}
+
+		TEST_METHOD(TestLoadOnce)
+		{
+			GDBase::ResourceCache<int, int> cache;
+			std::atomic_int loads(0);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&cache, &loads]()
+				{
+					auto obj = cache.get(7, [&loads](int key)
+					{
+						loads++;
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+						return key;
+					});
+					Assert::AreEqual(*obj, 7);
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			Assert::AreEqual(loads.load(), 1);
+		}
+
+		TEST_METHOD(TestGetThreadsGrow)
+		{
+			//Distinct keys held by every thread make the cache grow past its initial size while other threads use it.
+			GDBase::ResourceCache<int, int> cache(100, 1000);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 8; t++)
+			{
+				threads.emplace_back([&cache, t]()
+				{
+					std::vector<GDBase::PoolObject<int>> held;
+					for (int i = 0; i < 1000; i++)
+					{
+						auto key = t * 1000 + i;
+						held.push_back(cache.get(key, [](int key) { return key * 2; }));
+						Assert::AreEqual(*held.back(), key * 2);
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			Assert::AreEqual(cache.idleCount() <= 100, true);
+		}
+	};
+
+	TEST_CLASS(MessageQueueTests)
+	{
+	public:
+		TEST_METHOD(TestPushPopOrder)
+		{
+			GDBase::MPMCIndexQueue queue(4);
+			GDBase::PoolIndex index;
+			Assert::AreEqual(queue.pop(index), false);
+			for (GDBase::PoolIndex i = 0; i < 4; i++)
+			{
+				Assert::AreEqual(queue.push(i), true);
+			}
+			Assert::AreEqual(queue.push(4), false);
+
+			for (GDBase::PoolIndex i = 0; i < 4; i++)
+			{
+				Assert::AreEqual(queue.pop(index), true);
+				Assert::AreEqual(index, i);
+			}
+			Assert::AreEqual(queue.pop(index), false);
+		}
+
+		TEST_METHOD(TestMultiple)
+		{
+			GDBase::MPSCIndexQueue queue(8);
+			GDBase::PoolIndex in[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+			GDBase::PoolIndex out[10];
+
+			Assert::AreEqual(queue.pushMultiple(in, 10), (size_t)8);
+			Assert::AreEqual(queue.popMultiple(out, 3), (size_t)3);
+			Assert::AreEqual(queue.pushMultiple(in + 8, 2), (size_t)2);
+			Assert::AreEqual(queue.popMultiple(out + 3, 10), (size_t)7);
+			for (GDBase::PoolIndex i = 0; i < 10; i++)
+			{
+				Assert::AreEqual(out[i], i);
+			}
+		}
+
+		TEST_METHOD(TestDefaultPoolSize)
+		{
+			//The default pool holds a full queue and as many reserved payloads again.
+			GDBase::MessageQueue<int> queue(3000);
+			std::vector<bool> seen(queue.capacity() * 2);
+			for (size_t i = 0; i < queue.capacity(); i++)
+			{
+				auto index = queue.reserve();
+				Assert::AreEqual((bool)seen[index], false);
+				seen[index] = true;
+				Assert::AreEqual(queue.push(index), true);
+			}
+			for (size_t i = 0; i < queue.capacity(); i++)
+			{
+				auto index = queue.reserve();
+				Assert::AreEqual((bool)seen[index], false);
+				seen[index] = true;
+			}
+			Assert::AreEqual(queue.size(), queue.capacity());
+		}
+
+		TEST_METHOD(TestSendReceiveThreads)
+		{
+			GDBase::MessageQueue<std::string> queue(256, 1000);
+			std::atomic_size_t received(0), total(0);
+			std::vector<std::thread> threads;
+
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&queue]()
+				{
+					for (int i = 0; i < 2000; i++)
+					{
+						while (!queue.send(std::to_string(i)))
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+				threads.emplace_back([&queue, &received, &total]()
+				{
+					std::string msg;
+					while (received.load() < 8000)
+					{
+						if (queue.receive(msg))
+						{
+							total += std::stoul(msg);
+							received++;
+						}
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			Assert::AreEqual(total.load(), (size_t)4 * (1999 * 2000 / 2));
+			Assert::AreEqual(queue.isEmpty(), true);
+		}
+
+		TEST_METHOD(TestSingleConsumerBatches)
+		{
+			GDBase::MessageQueue<int, true> queue(64, 1000);
+			std::vector<std::thread> producers;
+			for (int t = 0; t < 3; t++)
+			{
+				producers.emplace_back([&queue]()
+				{
+					for (int i = 0; i < 1000; i++)
+					{
+						auto index = queue.reserve();
+						queue.at(index) = i;
+						while (!queue.push(index))
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+			}
+
+			size_t received = 0, total = 0;
+			GDBase::PoolIndex indices[16];
+			while (received < 3000)
+			{
+				auto count = queue.popMultiple(indices, 16);
+				for (size_t i = 0; i < count; i++)
+				{
+					total += queue.at(indices[i]);
+				}
+				queue.releaseMultiple(indices, count);
+				received += count;
+			}
+			for (auto& thread : producers)
+			{
+				thread.join();
+			}
+
+			Assert::AreEqual(total, (size_t)3 * (999 * 1000 / 2));
+		}
+	};
+
+	TEST_CLASS(JobSchedulerTests)
+	{
+	public:
+		TEST_METHOD(TestScheduleWait)
+		{
+			GDBase::JobScheduler scheduler(2);
+			std::atomic_int value(0);
+			auto job = scheduler.schedule([&value]() { value = 5; });
+			scheduler.wait(job);
+
+			Assert::AreEqual(scheduler.isFinished(job), true);
+			Assert::AreEqual(value.load(), 5);
+		}
+
+		TEST_METHOD(TestParentWaitsForChildren)
+		{
+			GDBase::JobScheduler scheduler(3);
+			std::atomic_int count(0);
+			auto parent = scheduler.create([]() {});
+			for (int i = 0; i < 100; i++)
+			{
+				scheduler.schedule([&count]()
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+					count++;
+				}, parent);
+			}
+			scheduler.run(parent);
+			scheduler.wait(parent);
+
+			Assert::AreEqual(count.load(), 100);
+		}
+
+		TEST_METHOD(TestParallelFor)
+		{
+			GDBase::JobScheduler scheduler(4);
+			std::vector<int> values(100000, 0);
+			scheduler.parallelFor(0, values.size(), [&values](size_t i) { values[i] = (int)i * 2; });
+
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				Assert::AreEqual(values[i], (int)i * 2);
+			}
+		}
+
+		TEST_METHOD(TestNestedMoreJobsThanPool)
+		{
+			GDBase::JobScheduler scheduler(4, 64);
+			std::atomic_size_t sum(0);
+			scheduler.parallelFor(0, 100, [&scheduler, &sum](size_t i)
+			{
+				scheduler.parallelFor(0, 100, [&sum, i](size_t j) { sum += i * j; }, 1);
+			}, 1);
+
+			Assert::AreEqual(sum.load(), (size_t)(4950 * 4950));
+		}
+	};
+
+	TEST_CLASS(FixedObjectPoolTests)
+	{
+	public:
+		TEST_METHOD(TestReserveUntilFull)
+		{
+			GDBase::FixedObjectPool<std::string, 70> pool;
+			for (GDBase::PoolIndex i = 0; i < 70; i++)
+			{
+				Assert::AreEqual(pool.reserve(), i);
+			}
+			Assert::AreEqual(pool.reserve(), GDBASE_INVALID_ID);
+			Assert::AreEqual(pool.isFull(), true);
+
+			pool.release(65);
+			Assert::AreEqual(pool.isInUse(65), false);
+			Assert::AreEqual(pool.reserve(), (GDBase::PoolIndex)65);
+		}
+
+		TEST_METHOD(TestReserveMultiple)
+		{
+			GDBase::FixedObjectPool<int, 100> pool;
+			GDBase::PoolIndex ids[100];
+			Assert::AreEqual(pool.reserveMultiple(ids, 10), (size_t)10);
+			pool.release(3);
+			Assert::AreEqual(pool.reserveMultiple(ids, 200), (size_t)91);
+			Assert::AreEqual(ids[0], (GDBase::PoolIndex)3);
+			Assert::AreEqual(ids[1], (GDBase::PoolIndex)10);
+			Assert::AreEqual(pool.size(), (size_t)100);
+		}
+
+		TEST_METHOD(TestIteration)
+		{
+			GDBase::FixedObjectPool<int, 130> pool(-1);
+			for (int i = 0; i < 130; i++)
+			{
+				pool.at(pool.reserve()) = i;
+			}
+			for (size_t i = 0; i < 130; i += 3)
+			{
+				pool.release(i);
+			}
+
+			size_t count = 0;
+			for (auto& value : pool)
+			{
+				Assert::AreNotEqual(value % 3, 0);
+				count++;
+			}
+			Assert::AreEqual(count, pool.size());
+
+			int sum = 0;
+			pool.forEach([&sum](size_t index, int& value) { Assert::AreEqual((int)index, value); sum += value; });
+			Assert::AreEqual(sum, 129 * 130 / 2 - 3 * (43 * 44 / 2));
+		}
+
+		TEST_METHOD(TestReserveThreads)
+		{
+			GDBase::FixedObjectPool<int, 256> pool;
+			std::vector<std::thread> threads;
+			std::vector<size_t> ids[4];
+			for (int t = 0; t < 4; t++)
+			{
+				threads.emplace_back([&pool, &ids, t]()
+				{
+					for (int i = 0; i < 64; i++)
+					{
+						ids[t].push_back(pool.reserve());
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			bool seen[256] = {};
+			for (auto& threadIds : ids)
+			{
+				for (auto id : threadIds)
+				{
+					Assert::AreEqual(seen[id], false);
+					seen[id] = true;
+				}
+			}
+			Assert::AreEqual(pool.isFull(), true);
+		}
+	};
+
+	TEST_CLASS(EntityRegistryTests)
+	{
+	public:
+		struct Position
+		{
+			int x, y;
+		};
+
+		struct Velocity
+		{
+			int dx, dy;
+		};
+
+		TEST_METHOD(TestComponents)
+		{
+			GDBase::EntityRegistry registry;
+			auto entity = registry.create();
+			registry.emplace<Position>(entity, 1, 2);
+			registry.emplace<std::string>(entity, "name");
+
+			Assert::AreEqual(registry.has<Position>(entity), true);
+			Assert::AreEqual(registry.has<Velocity>(entity), false);
+			Assert::AreEqual(registry.get<Position>(entity).y, 2);
+			Assert::AreEqual(registry.get<std::string>(entity), std::string("name"));
+			Assert::AreEqual(registry.tryGet<Velocity>(entity) == nullptr, true);
+
+			registry.remove<Position>(entity);
+			Assert::AreEqual(registry.has<Position>(entity), false);
+			Assert::AreEqual(registry.storage<Position>().size(), (size_t)0);
+		}
+
+		TEST_METHOD(TestDestroy)
+		{
+			GDBase::EntityRegistry registry;
+			auto first = registry.create();
+			auto second = registry.create();
+			registry.emplace<Position>(first, 1, 1);
+			registry.emplace<Position>(second, 2, 2);
+			registry.emplace<Velocity>(first, 3, 3);
+
+			registry.destroy(first);
+			Assert::AreEqual(registry.isAlive(first), false);
+			Assert::AreEqual(registry.storage<Position>().size(), (size_t)1);
+			Assert::AreEqual(registry.storage<Velocity>().size(), (size_t)0);
+			Assert::AreEqual(registry.get<Position>(second).x, 2);
+
+			auto third = registry.create();
+			Assert::AreEqual(third, first);
+			Assert::AreEqual(registry.has<Position>(third), false);
+		}
+
+		template <size_t N>
+		struct Tag
+		{
+			size_t value;
+		};
+
+		template <size_t... Ns>
+		static void testManyTypes(std::index_sequence<Ns...>)
+		{
+			GDBase::EntityRegistry registry;
+			auto entity = registry.create();
+			(registry.emplace<Tag<Ns>>(entity, Ns), ...);
+			Assert::AreEqual((registry.has<Tag<Ns>>(entity) && ...), true);
+			Assert::AreEqual(((registry.get<Tag<Ns>>(entity).value == Ns) && ...), true);
+
+			registry.remove<Tag<sizeof...(Ns) - 1>>(entity);
+			Assert::AreEqual(registry.has<Tag<sizeof...(Ns) - 1>>(entity), false);
+
+			registry.destroy(entity);
+			Assert::AreEqual(((registry.storage<Tag<Ns>>().size() == 0) && ...), true);
+		}
+
+		TEST_METHOD(TestMoreTypesThanMask)
+		{
+			//Type ids are shared by the whole program, so these go past GDBASE_ECS_MAX_COMPONENTS.
+			testManyTypes(std::make_index_sequence<GDBASE_ECS_MAX_COMPONENTS + 8>());
+		}
+
+		TEST_METHOD(TestView)
+		{
+			GDBase::EntityRegistry registry;
+			for (int i = 0; i < 3000; i++)
+			{
+				auto entity = registry.create();
+				registry.emplace<Position>(entity, i, 0);
+				if (i % 3 == 0)
+				{
+					registry.emplace<Velocity>(entity, 1, 2);
+				}
+			}
+
+			size_t visited = 0;
+			registry.view<Position, Velocity>().each([&visited](size_t entity, Position& position, Velocity& velocity)
+			{
+				Assert::AreEqual((size_t)position.x, entity);
+				position.y += velocity.dy;
+				visited++;
+			});
+			Assert::AreEqual(visited, (size_t)1000);
+			Assert::AreEqual(registry.get<Position>(3).y, 2);
+			Assert::AreEqual(registry.get<Position>(4).y, 0);
+		}
+
+		TEST_METHOD(TestViewRemoveCurrent)
+		{
+			GDBase::EntityRegistry registry;
+			for (int i = 0; i < 100; i++)
+			{
+				auto entity = registry.create();
+				registry.emplace<Position>(entity, i, 0);
+			}
+
+			size_t visited = 0;
+			registry.view<Position>().each([&registry, &visited](size_t entity, Position&)
+			{
+				registry.remove<Position>(entity);
+				visited++;
+			});
+			Assert::AreEqual(visited, (size_t)100);
+			Assert::AreEqual(registry.storage<Position>().isEmpty(), true);
+		}
+
+		TEST_METHOD(TestParallelView)
+		{
+			GDBase::EntityRegistry registry;
+			GDBase::JobScheduler scheduler(3);
+			for (int i = 0; i < 5000; i++)
+			{
+				auto entity = registry.create();
+				registry.emplace<Velocity>(entity, i, 1);
+				if (i % 2 == 0)
+				{
+					registry.emplace<Position>(entity, 0, 0);
+				}
+			}
+
+			registry.view<Position, Velocity>().parallelEach(scheduler, [](size_t, Position& position, Velocity& velocity)
+			{
+				position.x += velocity.dx;
+			});
+
+			long long sum = 0;
+			registry.view<Position>().each([&sum](size_t, Position& position) { sum += position.x; });
+			Assert::AreEqual(sum, 2500LL * 4998 / 2);
+		}
+	};
+
+	TEST_CLASS(FrameObjectPoolTests)
+	{
+	public:
+		TEST_METHOD(TestReserve)
+		{
+			GDBase::FrameObjectPool<int> pool;
+			auto first = pool.reserve();
+			auto second = pool.reserve();
+			Assert::AreEqual(second, first + 1);
+
+			auto range = pool.reserveMultiple(10);
+			Assert::AreEqual(range, second + 1);
+
+			auto large = pool.reserveMultiple(GDBASE_OBJECTPOOL_BLOCK_SIZE);	//Does not fit the rest of the first block.
+			Assert::AreEqual(large % GDBASE_OBJECTPOOL_BLOCK_SIZE, (GDBase::PoolIndex)0);
+			Assert::AreEqual(pool.getBlocksInUse(), (size_t)2);
+			Assert::AreEqual(pool.getCapacity(), (size_t)2 * GDBASE_OBJECTPOOL_BLOCK_SIZE);
+		}
+
+		TEST_METHOD(TestReleaseAll)
+		{
+			GDBase::FrameObjectPool<std::string> pool("empty");
+			auto first = pool.reserve();
+			pool.at(first) = "frame 0";
+			for (int i = 0; i < 2500; i++)
+			{
+				pool.reserve();
+			}
+			pool.releaseAll();
+
+			Assert::AreEqual(pool.getBlocksInUse(), (size_t)0);
+			Assert::AreEqual(pool.getFrame(), (uint64_t)1);
+			Assert::AreEqual(pool.reserve(), first);
+			Assert::AreEqual(pool.at(first), std::string("frame 0"));
+
+			pool.endFrame(true);
+			Assert::AreEqual(pool.at(first), std::string("empty"));
+			Assert::AreEqual(pool.getCapacity(), (size_t)3 * GDBASE_OBJECTPOOL_BLOCK_SIZE);
+		}
+
+		TEST_METHOD(TestCursorCacheDropsDestroyed)
+		{
+			size_t cached = 0;
+			std::thread([&cached]()
+			{
+				for (int i = 0; i < 50; i++)
+				{
+					GDBase::FrameObjectPool<int> pool(0, 0);
+					pool.reserve();
+				}
+				GDBase::FrameObjectPool<int> last(0, 0);
+				last.reserve();
+				cached = GDBase::impl::FrameCursorCache::current().size();
+			}).join();
+			Assert::AreEqual(cached, (size_t)1);
+		}
+
+		TEST_METHOD(TestReserveLimits)
+		{
+			GDBase::FrameObjectPool<char> pool;
+			Assert::AreEqual(pool.reserveMultiple(GDBASE_OBJECTPOOL_BLOCK_SIZE + 1), GDBASE_INVALID_ID);
+			Assert::AreEqual(pool.getBlocksInUse(), (size_t)0);
+
+			for (size_t block = 0; block < GDBASE_OBJECTPOOL_MAX_BLOCKS; block++)
+			{
+				Assert::AreEqual(pool.reserveMultiple(GDBASE_OBJECTPOOL_BLOCK_SIZE), (GDBase::PoolIndex)(block * GDBASE_OBJECTPOOL_BLOCK_SIZE));
+			}
+			Assert::AreEqual(pool.reserve(), GDBASE_INVALID_ID);
+			Assert::AreEqual(pool.getBlocksInUse(), (size_t)GDBASE_OBJECTPOOL_MAX_BLOCKS);
+
+			pool.releaseAll();
+			Assert::AreEqual(pool.reserve(), (GDBase::PoolIndex)0);
+		}
+
+		TEST_METHOD(TestReserveThreads)
+		{
+			GDBase::FrameObjectPool<int> pool;
+			for (int frame = 0; frame < 3; frame++)
+			{
+				std::vector<std::thread> threads;
+				std::vector<size_t> ids[4];
+				for (int t = 0; t < 4; t++)
+				{
+					threads.emplace_back([&pool, &ids, t]()
+					{
+						for (int i = 0; i < 3000; i++)
+						{
+							ids[t].push_back(pool.reserve());
+						}
+					});
+				}
+				for (auto& thread : threads)
+				{
+					thread.join();
+				}
+
+				//Every thread claims its own blocks, so the objects handed out are all distinct.
+				std::vector<bool> seen(pool.getCapacity());
+				for (auto& threadIds : ids)
+				{
+					for (auto id : threadIds)
+					{
+						Assert::AreEqual((bool)seen[id], false);
+						seen[id] = true;
+					}
+				}
+				pool.releaseAll();
+			}
+		}
+	};
+
+
+	TEST_CLASS(SharedObjectPoolTests)
+	{
+	public:
+		struct Position
+		{
+			float x;
+			float y;
+		};
+
+		TEST_METHOD(TestCreateAndAttach)
+		{
+			GDBase::SharedObjectPool<Position>::remove("GDBaseTestsSharedPool");
+			GDBase::SharedObjectPool<Position> server, sidecar;
+			Assert::AreEqual(server.create("GDBaseTestsSharedPool", 100, Position{ -1.0f, -1.0f }), true);
+			Assert::AreEqual(sidecar.attach("GDBaseTestsSharedPool"), true);
+			Assert::AreEqual(sidecar.capacity(), (size_t)100);
+
+			//Both pools map the same region at different addresses.
+			auto id = server.reserve();
+			server.at(id) = Position{ 1.0f, 2.0f };
+			Assert::AreEqual(sidecar.isInUse(id), true);
+			Assert::AreEqual(sidecar.read(id).y, 2.0f);
+			Assert::AreEqual(sidecar.read(id + 1).x, -1.0f);
+
+			auto sidecarId = sidecar.reserve();
+			Assert::AreEqual(sidecarId, (GDBase::PoolIndex)1);
+			sidecar.release(id);
+			Assert::AreEqual(server.isInUse(id), false);
+			Assert::AreEqual(server.reserve(), id);
+			Assert::AreEqual(server.size(), (size_t)2);
+		}
+
+		TEST_METHOD(TestReadOnly)
+		{
+			GDBase::SharedObjectPool<Position>::remove("GDBaseTestsSharedPoolReadOnly");
+			GDBase::SharedObjectPool<Position> server, reader;
+			Assert::AreEqual(server.create("GDBaseTestsSharedPoolReadOnly", 70), true);
+			for (int i = 0; i < 70; i++)
+			{
+				server.at(server.reserve()) = Position{ (float)i, 0.0f };
+			}
+			Assert::AreEqual(server.reserve(), GDBASE_INVALID_ID);
+			server.release(10);
+
+			Assert::AreEqual(reader.attach("GDBaseTestsSharedPoolReadOnly", true), true);
+			Assert::AreEqual(reader.isReadOnly(), true);
+			Assert::AreEqual(reader.reserve(), GDBASE_INVALID_ID);
+
+			float sum = 0;
+			reader.forEach([&sum](GDBase::PoolIndex, const Position& position) { sum += position.x; });
+			Assert::AreEqual(sum, (float)(69 * 70 / 2 - 10));
+			Assert::AreEqual(reader.size(), (size_t)69);
+		}
+
+		TEST_METHOD(TestAttachValidation)
+		{
+			GDBase::SharedObjectPool<Position>::remove("GDBaseTestsSharedPoolValidation");
+			GDBase::SharedObjectPool<Position> server, other;
+			GDBase::SharedObjectPool<int> wrongType;
+			Assert::AreEqual(other.attach("GDBaseTestsSharedPoolValidation"), false);
+
+			Assert::AreEqual(server.create("GDBaseTestsSharedPoolValidation", 10), true);
+			Assert::AreEqual(other.create("GDBaseTestsSharedPoolValidation", 10), false);
+			Assert::AreEqual(wrongType.attach("GDBaseTestsSharedPoolValidation"), false);
+			Assert::AreEqual(wrongType.isOpen(), false);
+
+			server.close();
+			Assert::AreEqual(other.attach("GDBaseTestsSharedPoolValidation"), false);
+		}
+	};
+
+
+	TEST_CLASS(TimerWheelTests)
+	{
+	public:
+		TEST_METHOD(TestFiresOnExpiry)
+		{
+			GDBase::TimerWheel<uint64_t> wheel;
+			uint64_t delays[] = { 5, 1, 255, 256, 300, 70000, 1 << 24 };
+			for (auto delay : delays)
+			{
+				wheel.schedule(delay, delay);
+			}
+			Assert::AreEqual(wheel.size(), (size_t)7);
+
+			size_t fired = 0;
+			while (!wheel.isEmpty())
+			{
+				fired += wheel.advance(1, [&wheel](GDBase::TimerHandle, uint64_t& expiry) { Assert::AreEqual(wheel.now(), expiry); });
+			}
+			Assert::AreEqual(fired, (size_t)7);
+			Assert::AreEqual(wheel.now(), (uint64_t)(1 << 24));
+		}
+
+		TEST_METHOD(TestCancelAndReschedule)
+		{
+			GDBase::TimerWheel<int> wheel;
+			auto cancelled = wheel.schedule(10, 1);
+			auto moved = wheel.schedule(10, 2);
+			auto kept = wheel.schedule(10, 3);
+			Assert::AreEqual(wheel.cancel(cancelled), true);
+			Assert::AreEqual(wheel.cancel(cancelled), false);
+			Assert::AreEqual(wheel.reschedule(moved, 1000), true);
+
+			int sum = 0;
+			Assert::AreEqual(wheel.advance(10, [&sum](GDBase::TimerHandle, int& value) { sum += value; }), (size_t)1);
+			Assert::AreEqual(sum, 3);
+			Assert::AreEqual(wheel.isPending(kept), false);
+			Assert::AreEqual(wheel.reschedule(kept, 5), false);
+			Assert::AreEqual(wheel.isPending(moved), true);
+
+			//A new timer reuses the cancelled timer's record, but the old handle stays stale.
+			auto reused = wheel.schedule(1, 4);
+			Assert::AreEqual(reused.index == cancelled.index || reused.index == kept.index, true);
+			Assert::AreEqual(wheel.cancel(cancelled), false);
+			Assert::AreEqual(wheel.cancel(kept), false);
+
+			Assert::AreEqual(wheel.advance(1000, [&sum](GDBase::TimerHandle, int& value) { sum += value; }), (size_t)2);
+			Assert::AreEqual(sum, 9);
+		}
+
+		TEST_METHOD(TestPeriodic)
+		{
+			GDBase::TimerWheel<int> wheel;
+			wheel.schedule(100, 0);
+			size_t fired = wheel.advance(1000, [&wheel](GDBase::TimerHandle timer, int& count)
+			{
+				Assert::AreEqual(wheel.now(), (uint64_t)(100 * (count + 1)));
+				if (++count < 5)
+				{
+					wheel.reschedule(timer, 100);
+				}
+			});
+			Assert::AreEqual(fired, (size_t)5);
+			Assert::AreEqual(wheel.isEmpty(), true);
+		}
+
+		TEST_METHOD(TestBatchedAdvance)
+		{
+			GDBase::TimerWheel<uint64_t> wheel;
+			uint64_t seed = 1;
+			for (int i = 0; i < 20000; i++)
+			{
+				seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+				auto delay = (seed >> 33) % 5000000 + 1;
+				wheel.schedule(delay, delay);
+			}
+			wheel.schedule((uint64_t)1 << 34, (uint64_t)1 << 34);	//Past the range of the wheels.
+
+			size_t fired = 0;
+			uint64_t last = 0;
+			auto check = [&wheel, &last](GDBase::TimerHandle, uint64_t& expiry)
+			{
+				Assert::AreEqual(wheel.now(), expiry);
+				Assert::AreEqual(expiry >= last, true);
+				last = expiry;
+			};
+			for (uint64_t ticks = 1; wheel.now() < 5000000; ticks = ticks * 3 + 7)
+			{
+				fired += wheel.advance(ticks, check);
+			}
+			Assert::AreEqual(fired, (size_t)20000);
+			fired += wheel.advance((uint64_t)1 << 34, check);
+			Assert::AreEqual(fired, (size_t)20001);
+			Assert::AreEqual(wheel.isEmpty(), true);
+		}
+	};
+
+
+	TEST_CLASS(IndexMapTests)
+	{
+	public:
+		TEST_METHOD(TestInsertFindErase)
+		{
+			GDBase::IndexMap<uint64_t> map;
+			for (uint64_t key = 0; key < 10000; key++)
+			{
+				Assert::AreEqual(map.insert(key * 7919, (GDBase::PoolIndex)key), true);
+			}
+			Assert::AreEqual(map.insert(7919, 5), false);
+			Assert::AreEqual(map.find(7919), (GDBase::PoolIndex)1);
+			Assert::AreEqual(map.size(), (size_t)10000);
+
+			for (uint64_t key = 0; key < 10000; key += 2)
+			{
+				Assert::AreEqual(map.erase(key * 7919), true);
+			}
+			Assert::AreEqual(map.erase(0), false);
+			for (uint64_t key = 0; key < 10000; key++)
+			{
+				Assert::AreEqual(map.find(key * 7919), key % 2 == 0 ? GDBASE_INVALID_ID : (GDBase::PoolIndex)key);
+			}
+			Assert::AreEqual(map.find(1), GDBASE_INVALID_ID);
+
+			map.insertOrAssign(7919, 42);
+			Assert::AreEqual(map.find(7919), (GDBase::PoolIndex)42);
+			Assert::AreEqual(map.size(), (size_t)5000);
+		}
+
+		TEST_METHOD(TestDeletedSlotsReused)
+		{
+			GDBase::IndexMap<uint64_t> map(100);
+			auto capacity = map.capacity();
+			for (uint64_t key = 0; key < 100000; key++)
+			{
+				map.insert(key, (GDBase::PoolIndex)key);
+				if (key >= 50)
+				{
+					map.erase(key - 50);
+				}
+			}
+			Assert::AreEqual(map.capacity(), capacity);
+			Assert::AreEqual(map.size(), (size_t)50);
+			Assert::AreEqual(map.find(99999), (GDBase::PoolIndex)99999);
+		}
+
+		TEST_METHOD(TestFindMultiple)
+		{
+			GDBase::IndexMap<std::string> map;
+			std::vector<std::string> keys;
+			for (int i = 0; i < 100; i++)
+			{
+				keys.push_back("asset" + std::to_string(i));
+				if (i % 3 != 0)
+				{
+					map.insert(keys.back(), (GDBase::PoolIndex)i);
+				}
+			}
+
+			std::vector<GDBase::PoolIndex> indices(keys.size());
+			map.findMultiple(keys.data(), indices.data(), keys.size());
+			for (int i = 0; i < 100; i++)
+			{
+				Assert::AreEqual(indices[i], i % 3 != 0 ? (GDBase::PoolIndex)i : GDBASE_INVALID_ID);
+			}
+		}
+
+		TEST_METHOD(TestConcurrentReaders)
+		{
+			GDBase::ConcurrentIndexMap<uint64_t> map;
+			std::atomic<uint64_t> inserted(0);
+			std::atomic_bool failed(false);
+
+			std::vector<std::thread> readers;
+			for (int t = 0; t < 3; t++)
+			{
+				readers.emplace_back([&map, &inserted, &failed, t]()
+				{
+					uint64_t keys[8];
+					GDBase::PoolIndex indices[8];
+					for (uint64_t i = t; inserted.load() < 20000; i++)
+					{
+						auto limit = inserted.load();
+						if (limit == 0)
+						{
+							continue;
+						}
+						for (auto& key : keys)
+						{
+							key = (i++ * 2654435761ULL) % limit;
+						}
+						map.findMultiple(keys, indices, 8);
+						for (int k = 0; k < 8; k++)
+						{
+							if (indices[k] != (GDBase::PoolIndex)(keys[k] + 1))
+							{
+								failed.store(true);
+							}
+						}
+					}
+				});
+			}
+
+			//Keys below inserted are always present.
+			for (uint64_t key = 0; key < 20000; key++)
+			{
+				map.insert(key, (GDBase::PoolIndex)(key + 1));
+				inserted.store(key + 1);
+			}
+			for (auto& reader : readers)
+			{
+				reader.join();
+			}
+			map.reclaim();
+
+			Assert::AreEqual(failed.load(), false);
+			Assert::AreEqual(map.find(19999), (GDBase::PoolIndex)20000);
+		}
+	};
+
+
+	TEST_CLASS(ShardedObjectPoolTests)
+	{
+	public:
+		TEST_METHOD(TestReserveRelease)
+		{
+			GDBase::ShardedObjectPool<int> pool(4, -1);
+			auto shard = pool.localShard();
+			std::vector<GDBase::PoolIndex> ids;
+			for (int i = 0; i < 2500; i++)
+			{
+				ids.push_back(pool.reserve());
+				Assert::AreEqual(pool.shardOf(ids.back()), shard);
+				Assert::AreEqual(pool.at(ids.back()), -1);
+				pool.at(ids.back()) = i;
+			}
+			Assert::AreEqual(pool.getCapacity(), (size_t)3 * GDBASE_OBJECTPOOL_BLOCK_SIZE);
+			Assert::AreEqual(pool.size(), (size_t)2500);
+
+			for (int i = 0; i < 2500; i++)
+			{
+				Assert::AreEqual(pool.at(ids[i]), i);
+			}
+			pool.release(ids[1234]);
+			Assert::AreEqual(pool.isInUse(ids[1234]), false);
+			Assert::AreEqual(pool.reserve(), ids[1234]);
+		}
+
+		TEST_METHOD(TestStealing)
+		{
+			GDBase::ShardedObjectPool<int> pool(2);
+			std::vector<GDBase::PoolIndex> ids;
+			for (int i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+			{
+				ids.push_back(pool.reserveFrom(1));
+			}
+			for (auto id : ids)
+			{
+				pool.release(id);
+			}
+
+			//Shard 0 has no objects, so it takes shard 1's free ones and only grows once there are none left.
+			GDBase::PoolIndex stolen = 0;
+			for (int i = 0; i < GDBASE_OBJECTPOOL_BLOCK_SIZE; i++)
+			{
+				stolen = pool.reserveFrom(0);
+				Assert::AreEqual(pool.shardOf(stolen), (size_t)1);
+			}
+			Assert::AreEqual(pool.getCapacity(), (size_t)GDBASE_OBJECTPOOL_BLOCK_SIZE);
+			Assert::AreEqual(pool.shardOf(pool.reserveFrom(0)), (size_t)0);
+			Assert::AreEqual(pool.getCapacity(), (size_t)2 * GDBASE_OBJECTPOOL_BLOCK_SIZE);
+
+			pool.release(stolen);
+			Assert::AreEqual(pool.isInUse(stolen), false);
+		}
+
+		TEST_METHOD(TestReserveReleaseThreads)
+		{
+			GDBase::ShardedObjectPool<int> pool(3, -1);
+			std::atomic_bool failed(false);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 6; t++)
+			{
+				threads.emplace_back([&pool, &failed, t]()
+				{
+					std::vector<GDBase::PoolIndex> ids;
+					for (int round = 0; round < 200; round++)
+					{
+						for (int i = 0; i < 100; i++)
+						{
+							ids.push_back(pool.reserve());
+							if (pool.at(ids.back()) != -1)
+							{
+								failed.store(true);		//Handed out twice.
+							}
+							pool.at(ids.back()) = t;
+						}
+						for (auto id : ids)
+						{
+							if (pool.at(id) != t)
+							{
+								failed.store(true);
+							}
+							pool.at(id) = -1;
+							pool.release(id);
+						}
+						ids.clear();
+					}
+				});
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			Assert::AreEqual(failed.load(), false);
+			Assert::AreEqual(pool.size(), (size_t)0);
+		}
+	};
 }